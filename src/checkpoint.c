@@ -0,0 +1,483 @@
+#include <limits.h>
+#include "usched.h"
+
+int sched_checkpoint (const char * path) {
+	sigset_t block_sigset, old_sigset;
+
+	// block all signals (nothing may change while the state is written out)
+	sigfillset (&block_sigset);
+	if (sched_blocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+		return -1;
+	}
+
+	// save our own context; sched_restore resumes us right here
+	if (savectx (&current->pctx) == SCHED_RESTORE_RET) {
+		if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) { // unblock signals blocked above
+			fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+			fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+		}
+		return 1;
+	}
+
+	// write to a new file and rename it over path at the end: after a
+	//   sched_restore, the task stacks are private mappings of the file that
+	//   was restored, which must not be truncated under them (and a failed
+	//   checkpoint must not destroy the previous one)
+	char tmp_path[PATH_MAX];
+	int fd, rc;
+	rc = 0;
+	fd = -1;
+	if (snprintf (tmp_path, sizeof (tmp_path), "%s.tmp.%d", path, getpid ()) >= sizeof (tmp_path)) {
+		fprintf (stderr, "ERROR: Checkpoint %s could not be written!\n", path);
+		fprintf (stderr, "--> snprintf() failure: path too long\n");
+		rc = -1;
+	} else if ((fd = open (tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+		fprintf (stderr, "ERROR: Checkpoint %s could not be written!\n", path);
+		fprintf (stderr, "--> open() failure: %s\n", strerror (errno));
+		rc = -1;
+	}
+
+	// fill in the header
+	struct sched_ckpt_header hdr;
+	struct sched_procnode * pn;
+	struct sched_zombie * z;
+	memset (&hdr, 0, sizeof (hdr));
+	memcpy (hdr.magic, SCHED_CKPT_MAGIC, sizeof (SCHED_CKPT_MAGIC));
+	hdr.version = SCHED_CKPT_VERSION;
+	hdr.current_pid = current->pid;
+	hdr.pid_max = sched_pid_max;
+	hdr.ticks = sched_ticks;
+	hdr.trim_ticks = sched_trim_ticks;
+	hdr.wakeup_margin = sched_wakeup_margin;
+	hdr.mem = sched_mem;
+	hdr.text_addr = (void *) sched_switch;
+	hdr.data_addr = (void *) sched_hot;
+	hdr.libc_addr = (void *) stdout;
+	memcpy (hdr.groups, sched_groups, sizeof (sched_groups));
+	for (pn = proc_anchor.next; pn->proc != NULL; pn = pn->next) {
+		hdr.nproc += 1;
+		for (z = pn->proc->zombies; z != NULL; z = z->next) {
+			hdr.nproc += 1;
+		}
+	}
+
+	if (rc == 0 && write (fd, &hdr, sizeof (hdr)) != sizeof (hdr)) {
+		fprintf (stderr, "ERROR: Checkpoint %s could not be written!\n", path);
+		fprintf (stderr, "--> write() failure: %s\n", strerror (errno));
+		rc = -1;
+	}
+
+	// stacks go after the records, each at a page-aligned offset so that they can be mapped back
+	long page_size;
+	unsigned long long stack_off;
+	page_size = sysconf (_SC_PAGESIZE);
+	stack_off = sizeof (hdr) + hdr.nproc * sizeof (struct sched_ckpt_proc);
+	stack_off = (stack_off + page_size - 1) & ~(page_size - 1);
+
+	// write one record per process; only the part of a stack above the saved
+	//   stack pointer (and its red zone) is in use, so only those pages are saved
+	struct sched_ckpt_proc rec;
+	for (pn = proc_anchor.next; rc == 0 && pn->proc != NULL; pn = pn->next) {
+		memset (&rec, 0, sizeof (rec));
+		rec.hot = *pn->proc->hot;
+		rec.hot.proc = NULL;
+		rec.pid = pn->proc->pid;
+		rec.ppid = sched_parent (&pn->proc->plink)->pid;
+		rec.exit_code = pn->proc->exit_code;
+		rec.stack_base = pn->proc->stack_base;
+		rec.pctx = pn->proc->pctx;
+		rec.run_delay = pn->proc->run_delay;
+		rec.pcount = pn->proc->pcount;
+		rec.spawn_fn = pn->proc->spawn_fn;
+		rec.spawn_arg = pn->proc->spawn_arg;
+		rec.wake_pending = pn->proc->wake_pending;
+		rec.subreaper = pn->proc->subreaper;
+		rec.wake_tick = pn->proc->timer_node.proc != NULL ? pn->proc->wake_tick : 0;
+
+		if (pn->proc->stack_base != NULL) {
+			unsigned long stack_lo;
+			stack_lo = (unsigned long) pn->proc->pctx.regs[JB_SP] - SCHED_CKPT_REDZONE;
+			stack_lo &= ~(page_size - 1);
+			if (stack_lo < (unsigned long) pn->proc->stack_base - STACK_SIZE) {
+				stack_lo = (unsigned long) pn->proc->stack_base - STACK_SIZE;
+			}
+
+			rec.stack_off = stack_off;
+			rec.stack_len = (unsigned long) pn->proc->stack_base - stack_lo;
+			stack_off += rec.stack_len;
+		}
+
+		if (write (fd, &rec, sizeof (rec)) != sizeof (rec)) {
+			fprintf (stderr, "ERROR: Checkpoint %s could not be written!\n", path);
+			fprintf (stderr, "--> write() failure: %s\n", strerror (errno));
+			rc = -1;
+		}
+	}
+
+	// the zombies follow the living processes (their parents), as compact records
+	for (pn = proc_anchor.next; rc == 0 && pn->proc != NULL; pn = pn->next) {
+		for (z = pn->proc->zombies; rc == 0 && z != NULL; z = z->next) {
+			memset (&rec, 0, sizeof (rec));
+			rec.hot = sched_hot[z->pid];
+			rec.hot.proc = NULL;
+			rec.pid = z->pid;
+			rec.ppid = sched_parent (&z->plink)->pid;
+			rec.exit_code = z->exit_code;
+			rec.ru = z->ru;
+
+			if (write (fd, &rec, sizeof (rec)) != sizeof (rec)) {
+				fprintf (stderr, "ERROR: Checkpoint %s could not be written!\n", path);
+				fprintf (stderr, "--> write() failure: %s\n", strerror (errno));
+				rc = -1;
+			}
+		}
+	}
+
+	// write the stacks (same order and same offsets as computed above)
+	stack_off = sizeof (hdr) + hdr.nproc * sizeof (struct sched_ckpt_proc);
+	stack_off = (stack_off + page_size - 1) & ~(page_size - 1);
+	for (pn = proc_anchor.next; rc == 0 && pn->proc != NULL; pn = pn->next) {
+		if (pn->proc->stack_base == NULL) continue;
+
+		unsigned long stack_lo;
+		stack_lo = (unsigned long) pn->proc->pctx.regs[JB_SP] - SCHED_CKPT_REDZONE;
+		stack_lo &= ~(page_size - 1);
+		if (stack_lo < (unsigned long) pn->proc->stack_base - STACK_SIZE) {
+			stack_lo = (unsigned long) pn->proc->stack_base - STACK_SIZE;
+		}
+
+		size_t len;
+		len = (unsigned long) pn->proc->stack_base - stack_lo;
+		if (pwrite (fd, (void *) stack_lo, len, stack_off) != len) {
+			fprintf (stderr, "ERROR: Checkpoint %s could not be written!\n", path);
+			fprintf (stderr, "--> pwrite() failure: %s\n", strerror (errno));
+			rc = -1;
+		}
+		stack_off += len;
+	}
+
+	if (fd >= 0 && close (fd) < 0 && rc == 0) {
+		fprintf (stderr, "ERROR: Checkpoint %s could not be written!\n", path);
+		fprintf (stderr, "--> close() failure: %s\n", strerror (errno));
+		rc = -1;
+	}
+	if (rc == 0 && rename (tmp_path, path) < 0) {
+		fprintf (stderr, "ERROR: Checkpoint %s could not be written!\n", path);
+		fprintf (stderr, "--> rename() failure: %s\n", strerror (errno));
+		rc = -1;
+	}
+	if (rc < 0 && fd >= 0) {
+		unlink (tmp_path);
+	}
+
+	// unblock and restore signals
+	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+	}
+
+	return rc;
+}
+
+// undo a restore that failed halfway: unmap the stacks mapped so far and free
+//   the processes rebuilt so far, leaving an empty scheduler behind
+static void sched_restore_undo () {
+	struct sched_procnode * pn, * next;
+	struct sched_proc * proc;
+	struct sched_zombie * z;
+	int i;
+
+	for (pn = proc_anchor.next; pn->proc != NULL; pn = next) {
+		next = pn->next;
+		proc = pn->proc;
+		if (proc->stack_base != NULL) {
+			munmap (proc->stack_base - STACK_SIZE, STACK_SIZE);
+		}
+		while ((z = proc->zombies) != NULL) {
+			proc->zombies = z->next;
+			free (z);
+		}
+		free (proc->sib_procnode);
+		free (proc->zrec);
+		free (proc->child_link);
+		free (proc);
+		free (pn);
+	}
+
+	memset (pid_table, 0, sizeof (pid_table));
+	for (i = 0; i < SCHED_NPROC + 1; ++i) {
+		sched_hot[i].task_state = SCHED_UNUSED;
+		sched_hot[i].proc = NULL;
+	}
+	proc_anchor.prev = &proc_anchor;
+	proc_anchor.next = &proc_anchor;
+	sleep_anchor.prev = &sleep_anchor;
+	sleep_anchor.next = &sleep_anchor;
+	timer_anchor.prev = &timer_anchor;
+	timer_anchor.next = &timer_anchor;
+	current = NULL;
+}
+
+signed short int sched_restore (const char * path) {
+	int i, fd;
+
+	if ((fd = open (path, O_RDONLY)) < 0) {
+		fprintf (stderr, "ERROR: Checkpoint %s could not be restored!\n", path);
+		fprintf (stderr, "--> open() failure: %s\n", strerror (errno));
+		return -1;
+	}
+
+	// read and check the header
+	struct sched_ckpt_header hdr;
+	if (read (fd, &hdr, sizeof (hdr)) != sizeof (hdr)
+		|| memcmp (hdr.magic, SCHED_CKPT_MAGIC, sizeof (SCHED_CKPT_MAGIC)) != 0
+		|| hdr.version != SCHED_CKPT_VERSION || hdr.nproc == 0 || hdr.pid_max > SCHED_NPROC) {
+		fprintf (stderr, "ERROR: Checkpoint %s could not be restored!\n", path);
+		fprintf (stderr, "--> %s is not a checkpoint file\n", path);
+		close (fd);
+		return -1;
+	}
+
+	if (hdr.text_addr != (void *) sched_switch || hdr.data_addr != (void *) sched_hot || hdr.libc_addr != (void *) stdout) {
+		fprintf (stderr, "ERROR: Checkpoint %s could not be restored!\n", path);
+		fprintf (stderr, "--> program layout differs from the one that wrote it (is address randomization on?)\n");
+		close (fd);
+		return -1;
+	}
+
+	// start from an empty scheduler, as sched_init does
+	sched_clock_init ();
+	memset (pid_table, 0, sizeof (pid_table));
+	for (i = 0; i < SCHED_NPROC + 1; ++i) {
+		sched_hot[i].task_state = SCHED_UNUSED;
+		sched_hot[i].proc = NULL;
+	}
+	proc_anchor.prev = &proc_anchor;
+	proc_anchor.next = &proc_anchor;
+	proc_anchor.proc = NULL;
+	sleep_anchor.prev = &sleep_anchor;
+	sleep_anchor.next = &sleep_anchor;
+	sleep_anchor.proc = NULL;
+	timer_anchor.prev = &timer_anchor;
+	timer_anchor.next = &timer_anchor;
+	timer_anchor.proc = NULL;
+	sched_mem = hdr.mem;
+	sched_mem.zombies = 0;                      // (recounted below)
+	sched_mem.zombie_bytes = 0;
+	sched_dead = NULL;
+	memcpy (sched_groups, hdr.groups, sizeof (sched_groups));
+	sched_ticks = hdr.ticks;
+	sched_trim_ticks = hdr.trim_ticks;
+	sched_wakeup_margin = hdr.wakeup_margin;
+	sched_wakee = NULL;
+	sched_subreapers = 0;                       // (recounted below)
+	sched_pid_max = hdr.pid_max;
+
+	// rebuild every process; living ones are in proc_anchor order, in which a
+	//   parent always comes before its children, and zombies come last
+	//   (they are read in batches into a local buffer: a large malloc would be
+	//   served by mmap and could land on top of one of the stacks to be mapped)
+	struct sched_ckpt_proc recs[SCHED_CKPT_BATCH], * rec;
+	struct sched_proc * proc;
+	struct sched_procnode * node1, * node2;
+	struct sched_zombie * z;
+	unsigned int nread, nbatch;
+	for (nread = 0, nbatch = 0, rec = recs; nread < hdr.nproc; ++nread, ++rec) {
+		if (rec == recs + nbatch) {
+			nbatch = hdr.nproc - nread < SCHED_CKPT_BATCH ? hdr.nproc - nread : SCHED_CKPT_BATCH;
+			if (read (fd, recs, nbatch * sizeof (struct sched_ckpt_proc)) != nbatch * sizeof (struct sched_ckpt_proc)) {
+				fprintf (stderr, "ERROR: Checkpoint %s could not be restored!\n", path);
+				fprintf (stderr, "--> read() failure: %s\n", strerror (errno));
+				close (fd);
+				sched_restore_undo ();
+				return -1;
+			}
+			rec = recs;
+		}
+
+		if (rec->pid == 0 || rec->pid > hdr.pid_max
+			|| (rec->pid != 1 && (rec->ppid == 0 || rec->ppid > hdr.pid_max || sched_hot[rec->ppid].proc == NULL))) {
+			fprintf (stderr, "ERROR: Checkpoint %s could not be restored!\n", path);
+			fprintf (stderr, "--> bad record for process %u\n", rec->pid);
+			close (fd);
+			sched_restore_undo ();
+			return -1;
+		}
+
+		// a zombie only needs its compact record, appended to the parent's zombie list
+		if (rec->hot.task_state == SCHED_ZOMBIE) {
+			if ((z = (struct sched_zombie *) malloc (sizeof (struct sched_zombie))) == NULL) {
+				fprintf (stderr, "ERROR: Checkpoint %s could not be restored!\n", path);
+				fprintf (stderr, "--> malloc() failure: %s\n", strerror (errno));
+				close (fd);
+				sched_restore_undo ();
+				return -1;
+			}
+			proc = sched_hot[rec->ppid].proc;
+			z->pid = rec->pid;
+			z->plink = proc->child_link;
+			z->plink->refs += 1;
+			z->exit_code = rec->exit_code;
+			z->ru = rec->ru;
+			z->next = NULL;
+
+			if (proc->zombies == NULL) {
+				proc->zombies = z;
+			} else {
+				proc->zombies_tail->next = z;
+			}
+			proc->zombies_tail = z;
+
+			sched_hot[rec->pid] = rec->hot;
+			sched_hot[rec->pid].proc = NULL;
+			pid_table[rec->pid] = 1;
+			sched_mem.zombies += 1;
+			sched_mem.zombie_bytes += sizeof (struct sched_zombie);
+			continue;
+		}
+
+		// (a process that is not completely set up is not on proc_anchor yet,
+		//   so what it already has is freed right here on error)
+		proc = (struct sched_proc *) malloc (sizeof (struct sched_proc));
+		node1 = (struct sched_procnode *) malloc (sizeof (struct sched_procnode));
+		node2 = (struct sched_procnode *) malloc (sizeof (struct sched_procnode));
+		if (proc != NULL) {
+			proc->zrec = NULL;
+			proc->child_link = NULL;
+		}
+		if (proc == NULL || node1 == NULL || node2 == NULL
+			|| (proc->zrec = (struct sched_zombie *) malloc (sizeof (struct sched_zombie))) == NULL
+			|| (proc->child_link = sched_plink_new (proc)) == NULL) {
+			fprintf (stderr, "ERROR: Checkpoint %s could not be restored!\n", path);
+			fprintf (stderr, "--> malloc() failure: %s\n", strerror (errno));
+			if (proc != NULL) {
+				free (proc->zrec);
+				free (proc->child_link);
+			}
+			free (proc);
+			free (node1);
+			free (node2);
+			close (fd);
+			sched_restore_undo ();
+			return -1;
+		}
+
+		// map the stack back at its original address, straight from the file
+		//   (the unsaved part below the saved stack pointer is fresh zero pages)
+		proc->stack_base = NULL;
+		if (rec->stack_len != 0) {
+			void * stack_lo, * saved_lo, * mapped;
+			stack_lo = rec->stack_base - STACK_SIZE;
+			saved_lo = rec->stack_base - rec->stack_len;
+			mapped = mmap (stack_lo, STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+			if (mapped != stack_lo
+				|| mmap (saved_lo, rec->stack_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, rec->stack_off) != saved_lo) {
+				fprintf (stderr, "ERROR: Checkpoint %s could not be restored!\n", path);
+				fprintf (stderr, "--> stack of process %u could not be mapped at %p: %s\n", rec->pid, stack_lo, strerror (errno));
+				if (mapped != MAP_FAILED) {
+					munmap (mapped, STACK_SIZE);    // (wherever it went, if the kernel ignored MAP_FIXED_NOREPLACE)
+				}
+				free (proc->zrec);
+				free (proc->child_link);
+				free (proc);
+				free (node1);
+				free (node2);
+				close (fd);
+				sched_restore_undo ();
+				return -1;
+			}
+			proc->stack_base = rec->stack_base;
+		}
+
+		proc->hot = &sched_hot[rec->pid];
+		*proc->hot = rec->hot;
+		proc->hot->proc = proc;
+		proc->pid = rec->pid;
+		proc->exit_code = rec->exit_code;
+		proc->pctx = rec->pctx;
+		proc->plink = rec->pid == 1 ? proc->child_link : sched_hot[rec->ppid].proc->child_link;
+		proc->plink->refs += 1;
+		proc->subreaper = rec->subreaper;
+		sched_subreapers += rec->subreaper;
+		proc->child_anchor.prev = &proc->child_anchor;
+		proc->child_anchor.next = &proc->child_anchor;
+		proc->child_anchor.proc = NULL;
+		proc->zombies = NULL;
+		proc->zombies_tail = NULL;
+		proc->sleep_node.proc = NULL;
+		proc->ready_since = sched_clock ();     // (timestamps of the old program mean nothing here)
+		proc->run_delay = rec->run_delay;
+		proc->pcount = rec->pcount;
+		proc->mbox = NULL;
+		proc->mbox_tail = NULL;
+		proc->wake_pending = rec->wake_pending;
+		proc->spawn_fn = rec->spawn_fn;
+		proc->spawn_arg = rec->spawn_arg;
+		proc->timer_node.proc = NULL;
+		proc->wake_tick = 0;
+		pid_table[rec->pid] = 1;
+
+		// sleepers start a new sleep (and may get trimmed again later),
+		//   and those in sched_pause_ticks keep their timeout
+		if (proc->hot->task_state == SCHED_SLEEPING) {
+			sched_sleep_enqueue (proc);
+			if (rec->wake_tick != 0) {
+				sched_timer_enqueue (proc, rec->wake_tick);
+			}
+		}
+
+		// append to the list of living processes
+		node1->proc = proc;
+		node1->prev = proc_anchor.prev;
+		node1->next = &proc_anchor;
+		proc_anchor.prev->next = node1;
+		proc_anchor.prev = node1;
+		proc->my_procnode = node1;
+
+		// insert at the front of the parent's list of children (init has no parent)
+		if (rec->pid == 1) {
+			free (node2);
+			free (proc->zrec);                      // init never becomes a zombie
+			proc->zrec = NULL;
+			proc->sib_procnode = NULL;
+		} else {
+			proc->sib_procnode = node2;
+			node2->proc = proc;
+			node2->prev = &proc->plink->parent->child_anchor;
+			node2->next = proc->plink->parent->child_anchor.next;
+			proc->plink->parent->child_anchor.next->prev = node2;
+			proc->plink->parent->child_anchor.next = node2;
+		}
+	}
+
+	close (fd);                                 // the stack mappings keep the file open
+
+	if ((current = sched_hot[hdr.current_pid].proc) == NULL) {
+		fprintf (stderr, "ERROR: Checkpoint %s could not be restored!\n", path);
+		fprintf (stderr, "--> process %u that wrote it is missing\n", hdr.current_pid);
+		sched_restore_undo ();
+		return -1;
+	}
+
+	// get the inbox ready for messages from other threads, and establish the
+	//   scheduler's signal handlers and start the tick timer (last, so that
+	//   nothing ticks if we have to give up)
+	if (sched_inbox_init () < 0 || sched_settimer () < 0) {
+		sched_restore_undo ();
+		return -1;
+	}
+
+	// publish the stats table (we can do without it)
+	sched_stats_open (NULL);
+
+	// save global context (this allows the init process to return to the container)
+	if (savectx (&global_ctx) == SCHED_INIT_RET) {
+		return 0;
+	}
+
+	// transfer execution back into sched_checkpoint of the task that wrote the file
+	sched_run_start = sched_clock ();
+	restorectx (&current->pctx, SCHED_RESTORE_RET);
+}
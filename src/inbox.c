@@ -0,0 +1,323 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include "usched.h"
+
+// message posted to the inbox (and then, for SCHED_MSG_DATA, kept in the
+//   mailbox of the target process until sched_recv takes it)
+struct sched_msg {
+	struct sched_msg * _Atomic next;     // next message in the inbox (or mailbox)
+	unsigned short int type;             // SCHED_MSG_SPAWN, SCHED_MSG_WAKE or SCHED_MSG_DATA
+	unsigned int pid;                    // target process (WAKE, DATA)
+	void (* fn) (void *);                // function to run (SPAWN)
+	void * arg;                          // its argument (SPAWN)
+	void * stack;                        // stack mapped by the poster (SPAWN)
+	struct sched_proc * proc;            // sched_proc allocated by the poster, until the scheduler takes it (SPAWN)
+	size_t len;                          // length of data (DATA)
+	char data[];                         // the message itself (DATA)
+};
+
+// the inbox is a multi-producer single-consumer queue (Vyukov): a poster
+//   swaps itself in as the head and then links the old head to itself;
+//   only the scheduler thread takes messages off at the tail, and the stub
+//   keeps the queue from ever being empty (so neither end needs a lock)
+static struct sched_msg inbox_stub;
+static struct sched_msg * _Atomic inbox_head = &inbox_stub;
+static struct sched_msg * inbox_tail = &inbox_stub;
+static atomic_int inbox_idle;                   // 1 while the scheduler is blocked in sched_inbox_idle
+static atomic_int inbox_posted;                 // 1 once anything has been posted (some thread may post again)
+static struct sched_msg * _Atomic inbox_spent;  // messages the scheduler is done with, freed by sched_inbox_reclaim
+static int inbox_efd = -1;                      // eventfd doorbell of an idle scheduler
+
+static void sched_inbox_push (struct sched_msg * m) {
+	struct sched_msg * prev;
+
+	atomic_store_explicit (&m->next, NULL, memory_order_relaxed);
+	prev = atomic_exchange (&inbox_head, m);
+	atomic_store_explicit (&prev->next, m, memory_order_release);
+}
+
+static struct sched_msg * sched_inbox_pop () {
+	struct sched_msg * tail, * next;
+
+	tail = inbox_tail;
+	next = atomic_load_explicit (&tail->next, memory_order_acquire);
+
+	// step over the stub
+	if (tail == &inbox_stub) {
+		if (next == NULL) return NULL;
+		inbox_tail = next;
+		tail = next;
+		next = atomic_load_explicit (&next->next, memory_order_acquire);
+	}
+
+	if (next != NULL) {
+		inbox_tail = next;
+		return tail;
+	}
+
+	// tail is the last message; if a poster has already swapped itself in
+	//   but not linked yet, leave it for the next drain
+	if (tail != atomic_load_explicit (&inbox_head, memory_order_acquire)) return NULL;
+
+	// put the stub back behind the last message so that it can be taken
+	sched_inbox_push (&inbox_stub);
+	next = atomic_load_explicit (&tail->next, memory_order_acquire);
+	if (next != NULL) {
+		inbox_tail = next;
+		return tail;
+	}
+
+	return NULL;
+}
+
+// hand a message back (scheduler thread only): the scheduler may take
+//   messages in its tick handler, where it must not call free, so they
+//   are freed later by sched_inbox_reclaim (everyone who takes the list
+//   takes all of it at once, so a plain push cannot suffer from ABA)
+static void sched_inbox_spend (struct sched_msg * m) {
+	struct sched_msg * top;
+
+	top = atomic_load_explicit (&inbox_spent, memory_order_relaxed);
+	do {
+		atomic_store_explicit (&m->next, top, memory_order_relaxed);
+	} while (!atomic_compare_exchange_weak_explicit (&inbox_spent, &top, m, memory_order_release, memory_order_relaxed));
+}
+
+void sched_inbox_reclaim () {
+	struct sched_msg * m, * next;
+
+	for (m = atomic_exchange_explicit (&inbox_spent, NULL, memory_order_acquire); m != NULL; m = next) {
+		next = atomic_load_explicit (&m->next, memory_order_relaxed);
+		if (m->type == SCHED_MSG_SPAWN && m->proc != NULL) {
+			sched_freeproc (m->proc);           // (the process could not be spawned)
+			munmap (m->stack, STACK_SIZE);
+		}
+		free (m);
+	}
+}
+
+static int sched_inbox_post (struct sched_msg * m) {
+	uint64_t one;
+
+	atomic_store (&inbox_posted, 1);
+	sched_inbox_push (m);
+
+	// ring the doorbell only if the scheduler is blocked waiting for us
+	//   (the exchange in sched_inbox_push and this load are sequentially
+	//   consistent, so either we see the flag or the scheduler sees m)
+	if (atomic_load (&inbox_idle)) {
+		one = 1;
+		if (write (inbox_efd, &one, sizeof (one)) < 0) {
+			fprintf (stderr, "ERROR: Scheduler could not be woken up!\n");
+			fprintf (stderr, "--> write() failure: %s\n", strerror (errno));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int sched_post_spawn (void (* fn) (void *), void * arg) {
+	struct sched_msg * m;
+
+	sched_inbox_reclaim ();
+	if ((m = (struct sched_msg *) malloc (sizeof (struct sched_msg))) == NULL) {
+		fprintf (stderr, "ERROR: Message could not be posted!\n");
+		fprintf (stderr, "--> malloc() failure: %s\n", strerror (errno));
+		return -1;
+	}
+	m->type = SCHED_MSG_SPAWN;
+	m->fn = fn;
+	m->arg = arg;
+
+	// the stack and the sched_proc are set up here rather than by the scheduler
+	//   (which takes the message in its tick handler, where it must not allocate)
+	if ((m->stack = mmap (0, STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, 0, 0)) == MAP_FAILED) {
+		fprintf (stderr, "ERROR: Message could not be posted!\n");
+		fprintf (stderr, "--> mmap() failure: %s\n", strerror (errno));
+		free (m);
+		return -1;
+	}
+	if ((m->proc = sched_allocproc ()) == NULL) {
+		munmap (m->stack, STACK_SIZE);
+		free (m);
+		return -1;
+	}
+
+	return sched_inbox_post (m);
+}
+
+int sched_post_wake (unsigned int pid) {
+	struct sched_msg * m;
+
+	sched_inbox_reclaim ();
+	if ((m = (struct sched_msg *) malloc (sizeof (struct sched_msg))) == NULL) {
+		fprintf (stderr, "ERROR: Message could not be posted!\n");
+		fprintf (stderr, "--> malloc() failure: %s\n", strerror (errno));
+		return -1;
+	}
+	m->type = SCHED_MSG_WAKE;
+	m->pid = pid;
+
+	return sched_inbox_post (m);
+}
+
+int sched_post_msg (unsigned int pid, const void * buf, size_t len) {
+	struct sched_msg * m;
+
+	sched_inbox_reclaim ();
+	if ((m = (struct sched_msg *) malloc (sizeof (struct sched_msg) + len)) == NULL) {
+		fprintf (stderr, "ERROR: Message could not be posted!\n");
+		fprintf (stderr, "--> malloc() failure: %s\n", strerror (errno));
+		return -1;
+	}
+	m->type = SCHED_MSG_DATA;
+	m->pid = pid;
+	m->len = len;
+	memcpy (m->data, buf, len);
+
+	return sched_inbox_post (m);
+}
+
+int sched_inbox_init () {
+	if (inbox_efd < 0 && (inbox_efd = eventfd (0, EFD_CLOEXEC)) < 0) {
+		fprintf (stderr, "ERROR: Scheduler inbox could not be set up!\n");
+		fprintf (stderr, "--> eventfd() failure: %s\n", strerror (errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+int sched_inbox_drain () {
+	struct sched_msg * m;
+	struct sched_proc * proc;
+	int n;
+
+	for (n = 0; (m = sched_inbox_pop ()) != NULL; ++n) {
+		// spawned processes become children of init (on the stack and
+		//   sched_proc that came with the message)
+		if (m->type == SCHED_MSG_SPAWN) {
+			proc = sched_hot[1].proc != NULL ? sched_hot[1].proc : current;
+			if (sched_spawnat (proc, m->proc, m->stack, m->fn, m->arg, 0) < 0) {
+				fprintf (stderr, "ERROR: Posted process could not be spawned!\n");
+				fprintf (stderr, "--> sched_inbox_drain() failure\n");
+			} else {
+				m->proc = NULL;                     // (it is ours now)
+			}
+			sched_inbox_spend (m);
+			continue;
+		}
+
+		// drop messages for processes that do not exist (any more)
+		if (m->pid == 0 || m->pid > SCHED_NPROC || (proc = sched_hot[m->pid].proc) == NULL) {
+			sched_inbox_spend (m);
+			continue;
+		}
+
+		if (m->type == SCHED_MSG_DATA) {
+			// append to the mailbox (it is only touched by this thread)
+			atomic_store_explicit (&m->next, NULL, memory_order_relaxed);
+			if (proc->mbox == NULL) {
+				proc->mbox = m;
+			} else {
+				atomic_store_explicit (&proc->mbox_tail->next, m, memory_order_relaxed);
+			}
+			proc->mbox_tail = m;
+		} else {
+			sched_inbox_spend (m);
+		}
+
+		// remember a wakeup that comes while the process is awake (see sched_pause)
+		if (proc->hot->task_state != SCHED_SLEEPING) {
+			proc->wake_pending = 1;
+		}
+		sched_wakeup (proc);
+	}
+
+	return n;
+}
+
+int sched_inbox_idle () {
+	sigset_t term_sigset, old_sigset;
+	uint64_t n;
+	int rc;
+
+	// if no other thread has ever posted, nothing can wake us up: do not
+	//   hang (silently, with all signals blocked) but let the caller give up
+	if (inbox_efd < 0 || atomic_load (&inbox_posted) == 0) {
+		return -1;
+	}
+
+	// the program can still be interrupted or terminated while we wait
+	sigemptyset (&term_sigset);
+	sigaddset (&term_sigset, SIGINT);
+	sigaddset (&term_sigset, SIGTERM);
+	sigprocmask (SIG_UNBLOCK, &term_sigset, &old_sigset);
+
+	// announce that we are about to block, then look again (see sched_inbox_post)
+	rc = 0;
+	atomic_store (&inbox_idle, 1);
+	while (atomic_load (&inbox_head) == &inbox_stub && inbox_tail == &inbox_stub) {
+		if (read (inbox_efd, &n, sizeof (n)) < 0 && errno != EINTR) {
+			fprintf (stderr, "ERROR: Scheduler could not wait for its inbox!\n");
+			fprintf (stderr, "--> read() failure: %s\n", strerror (errno));
+			rc = -1;
+			break;
+		}
+	}
+	atomic_store (&inbox_idle, 0);
+
+	sigprocmask (SIG_SETMASK, &old_sigset, NULL);
+
+	return rc;
+}
+
+size_t sched_recv (void * buf, size_t len) {
+	sigset_t block_sigset, old_sigset;
+	struct sched_msg * m;
+	size_t rc;
+
+	// block all signals
+	sigfillset (&block_sigset);
+	if (sched_blocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+	}
+
+	// sleep until a message has been delivered
+	while (current->mbox == NULL) {
+		sched_sleep ();
+	}
+
+	m = current->mbox;
+	current->mbox = atomic_load_explicit (&m->next, memory_order_relaxed);
+	rc = m->len;
+	memcpy (buf, m->data, len < m->len ? len : m->len);
+	free (m);
+
+	// unblock and restore signals
+	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+	}
+
+	return rc;
+}
+
+long sched_poll () {
+	if (current->mbox == NULL) {
+		return -1;
+	}
+	return current->mbox->len;
+}
+
+void sched_mbox_free (struct sched_proc * proc) {
+	struct sched_msg * m;
+
+	while ((m = proc->mbox) != NULL) {
+		proc->mbox = atomic_load_explicit (&m->next, memory_order_relaxed);
+		free (m);
+	}
+}
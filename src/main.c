@@ -1,5 +1,5 @@
 #include <stdio.h>
-#include "sched.h"
+#include "usched.h"
 
 // preprocessor variables for easier testing
 #define CHILD_COUNT         5
@@ -1,7 +1,7 @@
 #include "jmpbuf-offsets64.h"
 
 struct savectx {
-	void *regs[JB_SIZE];
+	void *regs[JB_SIZE / sizeof (void *)]; // JB_SIZE is in bytes
 };
 
 int savectx(struct savectx *ctx);
@@ -1,14 +1,75 @@
-#include "sched.h"
+#if defined (__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#include "usched.h"
+
+struct savectx global_ctx;
+struct sched_proc * current;
+struct sched_procnode proc_anchor;
+struct sched_hot sched_hot[SCHED_NPROC + 1] __attribute__ ((aligned (64)));
+unsigned int sched_pid_max;
+unsigned short int pid_table[SCHED_NPROC + 1];
+struct sched_procnode sleep_anchor;
+struct sched_procnode timer_anchor;
+unsigned long long sched_trim_ticks;
+struct sched_proc * sched_dead;
+struct sched_memstat sched_mem;
+struct sched_group sched_groups[SCHED_NGROUP];
+unsigned long long sched_ticks;
+volatile unsigned long long sched_run_start;
+unsigned long long sched_tsc_mult;       // ns per TSC cycle (32.32 fixed point); 0 if the TSC is not used
+unsigned long long sched_tsc_base;       // TSC value at sched_ns_base
+unsigned long long sched_ns_base;        // CLOCK_MONOTONIC value at sched_tsc_base
+int sched_wakeup_margin;
+struct sched_proc * sched_wakee;
+unsigned int sched_subreapers;
 
 signed short int sched_init (void (* init_fn) ()) {
+	int i;
+
+	// pick and calibrate the clock for the cpu time accounting
+	sched_clock_init ();
+
 	// initialize pid_table to 0
-	memset (pid_table, 0, SCHED_NPROC + 1);
+	memset (pid_table, 0, sizeof (pid_table));
+
+	// mark every hot slot as unused
+	for (i = 0; i < SCHED_NPROC + 1; ++i) {
+		sched_hot[i].task_state = SCHED_UNUSED;
+		sched_hot[i].proc = NULL;
+	}
+
+	// set up the root task group (every process starts out in it)
+	memset (sched_groups, 0, sizeof (sched_groups));
+	sched_groups[0].in_use = 1;
+	sched_groups[0].parent = 0;
+	sched_groups[0].shares = SCHED_SHARES_DEFAULT;
+	sched_groups[0].nr_tasks = 1;               // the init process
+	sched_groups[0].nr_queued = 1;              // (which is about to run)
+	sched_ticks = 0;
 
 	// initialize the process anchor (doubly-linked list that holds all living processes)
 	proc_anchor.prev = &proc_anchor;
 	proc_anchor.next = &proc_anchor;
 	proc_anchor.proc = NULL;
 
+	// initialize the sleep queue and the memory accounting
+	sleep_anchor.prev = &sleep_anchor;
+	sleep_anchor.next = &sleep_anchor;
+	sleep_anchor.proc = NULL;
+	timer_anchor.prev = &timer_anchor;
+	timer_anchor.next = &timer_anchor;
+	timer_anchor.proc = NULL;
+	sched_trim_ticks = SCHED_TRIM_TICKS;
+	sched_dead = NULL;
+	memset (&sched_mem, 0, sizeof (sched_mem));
+
+	// wakeup preemption is on by default
+	sched_wakeup_margin = SCHED_WAKEUP_MARGIN;
+	sched_wakee = NULL;
+	sched_subreapers = 0;
+
 	// set up stack address space for init process
 	void * new_sp;
 	if ((new_sp = mmap (0, STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, 0, 0)) == MAP_FAILED) {
@@ -22,26 +83,52 @@ signed short int sched_init (void (* init_fn) ()) {
 	struct savectx init_ctx;
 	savectx (&init_ctx);                        // spill the registers into the struct savectx "init_ctx"
 	init_ctx.regs[JB_BP] = new_sp + STACK_SIZE; // set base pointer
-	init_ctx.regs[JB_SP] = new_sp + STACK_SIZE; // set stack pointer
+	init_ctx.regs[JB_SP] = new_sp + STACK_SIZE - sizeof (void *); // set stack pointer (as if init_fn had been called)
 	init_ctx.regs[JB_PC] = init_fn;             // and program counter
 
 	// set up new sched_proc for the init process
 	struct sched_proc proc_init;
-	proc_init.task_state = SCHED_RUNNING;       // this is going to be running here in a second
-	proc_init.cpu_time = 0;                     // no ticks on cpu so far (new process)
-	proc_init.slice_max = 21;                   // initialize time slice info
-	proc_init.slice_acc = 0;
-	proc_init.priority = 20;                    // default 20 as priority
-	proc_init.nice = 0;                         // default 0 as nice
+	proc_init.hot = &sched_hot[1];              // init owns hot slot 1
+	proc_init.hot->task_state = SCHED_RUNNING;  // this is going to be running here in a second
+	proc_init.hot->runtime = 0;                 // no time on cpu so far (new process)
+	proc_init.hot->slice_max = 21;              // initialize time slice info
+	proc_init.hot->slice_acc = 0;
+	proc_init.hot->sleep_avg = SCHED_SLEEP_AVG_MAX / 2; // no bonus either way
+	proc_init.hot->priority = 20;               // default 20 as priority
+	proc_init.hot->nice = 0;                    // default 0 as nice
+	proc_init.hot->group = 0;                   // init lives in the root group
+	proc_init.hot->proc = &proc_init;           // back pointer to the cold half
 	proc_init.pid = 1;                          // set init process id to 1
-	proc_init.ppid = 1;                         // it is its own parent
 	proc_init.exit_code = 0;                    // exit_code is 0 for now
 	proc_init.stack_base = new_sp + STACK_SIZE; // save pointer to bottom of stack in stack_base
 	proc_init.pctx = init_ctx;                  // contains context regs
-	proc_init.parent = &proc_init;              // contains pointer to itself
+	if ((proc_init.child_link = sched_plink_new (&proc_init)) == NULL) {
+		fprintf (stderr, "ERROR: Init process could not be created!\n");
+		fprintf (stderr, "--> malloc() failure: %s\n", strerror (errno));
+		munmap (new_sp, STACK_SIZE);
+		return -1;
+	}
+	proc_init.plink = proc_init.child_link;     // it is its own parent
+	proc_init.child_link->refs += 1;
+	proc_init.subreaper = 0;
 	proc_init.child_anchor.proc = NULL;         // anchor doesn't have associated process
 	proc_init.child_anchor.prev = &proc_init.child_anchor; // pointer to self
 	proc_init.child_anchor.next = &proc_init.child_anchor; // pointer to self
+	proc_init.zombies = NULL;                   // no exited children yet
+	proc_init.zombies_tail = NULL;
+	proc_init.zrec = NULL;                      // init never becomes a zombie
+	proc_init.sib_procnode = NULL;              // and has no parent's list to be in
+	proc_init.sleep_node.proc = NULL;           // not asleep
+	proc_init.ready_since = sched_clock ();     // no run delay accounted so far
+	proc_init.run_delay = 0;
+	proc_init.pcount = 1;                       // (it is switched to right below)
+	proc_init.mbox = NULL;                      // no messages yet
+	proc_init.mbox_tail = NULL;
+	proc_init.wake_pending = 0;
+	proc_init.spawn_fn = NULL;                  // (init runs init_fn)
+	proc_init.spawn_arg = NULL;
+	proc_init.timer_node.proc = NULL;           // no timeout pending
+	proc_init.wake_tick = 0;
 	
 	// set up init process procnode for the "living" process doubly-linked list
 	struct sched_procnode init_procnode;
@@ -57,17 +144,38 @@ signed short int sched_init (void (* init_fn) ()) {
 
 	// record in pid_table that pid 1 is now in use
 	pid_table[1] = 1;
+	sched_pid_max = 1;
+
+	// establish the scheduler's signal handlers and start the tick timer,
+	//   and get the inbox ready for messages from other threads
+	if (sched_settimer () < 0 || sched_inbox_init () < 0) {
+		return -1;
+	}
+
+	// publish the stats table (we can do without it)
+	sched_stats_open (NULL);
+
+	// save global context (this allows the init process to return to the container)
+	if (savectx (&global_ctx) == SCHED_INIT_RET) {
+		return 0;
+	}
+
+	// transfer execution to init_fn, which has its own user-level stack (init)
+	sched_run_start = sched_clock ();
+	restorectx (&proc_init.pctx, 0);
+}
 
+int sched_settimer () {
 	// establish sched_tick() as signal handler for that timer
 	if (signal (SIGVTALRM, sched_tick) == SIG_ERR) {
-		fprintf (stderr, "ERROR: Init process could not be created!\n");
+		fprintf (stderr, "ERROR: Scheduler timer could not be set up!\n");
 		fprintf (stderr, "--> signal() failure: %s\n", strerror (errno));
 		return -1;
 	}
 
-	// establish sched_ps() as signal handler for SIGABRT [abort() calls]
-	if (signal (SIGABRT, sched_ps) == SIG_ERR) {
-		fprintf (stderr, "ERROR: Init process could not be created!\n");
+	// establish sched_ps_abort() as signal handler for SIGABRT [abort() calls]
+	if (signal (SIGABRT, sched_ps_abort) == SIG_ERR) {
+		fprintf (stderr, "ERROR: Scheduler timer could not be set up!\n");
 		fprintf (stderr, "--> signal() failure: %s\n", strerror (errno));
 		return -1;
 	}
@@ -75,24 +183,18 @@ signed short int sched_init (void (* init_fn) ()) {
 	// set up itimer for every 100ms (one-hundred thousand microseconds)
 	struct itimerval itv;
 	itv.it_interval.tv_sec = 0;
-	itv.it_interval.tv_usec = 100000;
+	itv.it_interval.tv_usec = SCHED_TICK_NS / 1000;
 	itv.it_value.tv_sec = 0;
-	itv.it_value.tv_usec = 100000;
+	itv.it_value.tv_usec = SCHED_TICK_NS / 1000;
 
 	// set up periodic interval timer (setitimer)
 	if (setitimer (ITIMER_VIRTUAL, &itv, NULL) < 0) {
-		fprintf (stderr, "ERROR: Init process could not be created!\n");
+		fprintf (stderr, "ERROR: Scheduler timer could not be set up!\n");
 		fprintf (stderr, "--> setitimer() failure: %s\n", strerror (errno));
 		return -1;
 	}
 
-	// save global context (this allows the init process to return to the container)
-	if (savectx (&global_ctx) == SCHED_INIT_RET) {
-		return 0;
-	}
-
-	// transfer execution to init_fn, which has its own user-level stack (init)
-	restorectx (&proc_init.pctx, 0);
+	return 0;
 }
 
 int sched_fork () {
@@ -106,6 +208,9 @@ int sched_fork () {
 		return -1;
 	}
 
+	// release a task that exited before (never done where a task resumes, which may be a signal handler)
+	sched_release_dead ();
+
 	// set up stack address space for child process
 	void * new_sp;
 	if ((new_sp = mmap (0, STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, 0, 0)) == MAP_FAILED) {
@@ -118,8 +223,17 @@ int sched_fork () {
 		return -1;
 	}
 
-	// copy parent stack into child stack
-	memcpy (new_sp, (current->stack_base - STACK_SIZE), STACK_SIZE);
+	// copy the used part of the parent stack into the child stack (everything above
+	//   our own frame, plus some slack); the pages below are never touched, so they
+	//   do not become resident in the child
+	unsigned long copy_lo, page_size;
+	page_size = sysconf (_SC_PAGESIZE);
+	copy_lo = ((unsigned long) &new_sp - SCHED_FORK_SLACK) & ~(page_size - 1);
+	if (copy_lo < (unsigned long) current->stack_base - STACK_SIZE) {
+		copy_lo = (unsigned long) current->stack_base - STACK_SIZE;
+	}
+	memcpy (new_sp + STACK_SIZE - ((unsigned long) current->stack_base - copy_lo), (void *) copy_lo,
+		(unsigned long) current->stack_base - copy_lo);
 
 	// calculate stack offset from parent stack to child stack
 	unsigned long stack_offset = ((unsigned long) (new_sp + STACK_SIZE - current->stack_base));
@@ -127,6 +241,7 @@ int sched_fork () {
 	// set up context for new process (set base pointer and stack pointer to BOTTOM of stack address space)
 	struct savectx child_ctx;
 	if (savectx (&child_ctx) == SCHED_SWITCH_RET) {
+		sched_release_dead ();                  // (the child starts out outside the tick handler)
 		if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) { // unblock signals set in sched_switch
 			fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
 			fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
@@ -137,12 +252,13 @@ int sched_fork () {
 	child_ctx.regs[JB_BP] += stack_offset; // offset the base pointer and stack pointer for the
 	child_ctx.regs[JB_SP] += stack_offset; //   child's stack (given the parent's bp & sp)
 
-	// allocate memory for the new child process sched_proc (*current is the parent)
+	// create the child process around the new stack and context
 	struct sched_proc * child_proc;
-	if ((child_proc = (struct sched_proc *) malloc (sizeof (struct sched_proc))) == NULL) {
-		// no memory left! cannot create child process
-		fprintf (stderr, "ERROR: Child process could not be created!\n");
-		fprintf (stderr, "--> malloc() failure: %s\n", strerror (errno));
+	if ((child_proc = sched_allocproc ()) == NULL || sched_newproc (current, child_proc, new_sp, &child_ctx) == NULL) {
+		if (child_proc != NULL) {
+			sched_freeproc (child_proc);
+		}
+		munmap (new_sp, STACK_SIZE); // unmap the stack
 		if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) { // unblock signals
 			fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
 			fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
@@ -150,73 +266,145 @@ int sched_fork () {
 		return -1;
 	}
 
+	// unblock and restore signals
+	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+		return -1;
+	}
+
+	// return child pid to parent
+	return child_proc->pid;
+}
+
+struct sched_proc * sched_allocproc () {
+	struct sched_proc * proc;
+
+	// allocate memory for the sched_proc, its sched_procnodes (one for proc_anchor, one for
+	//   the parent's child_anchor), the zombie record it shrinks to on exit (so that sched_exit
+	//   cannot fail) and the link its children will share
+	if ((proc = (struct sched_proc *) malloc (sizeof (struct sched_proc))) == NULL) {
+		// no memory left! cannot create child process
+		fprintf (stderr, "ERROR: Child process could not be created!\n");
+		fprintf (stderr, "--> malloc() failure: %s\n", strerror (errno));
+		return NULL;
+	}
+	proc->my_procnode = proc->sib_procnode = NULL;
+	proc->zrec = NULL;
+	proc->child_link = NULL;
+	if ((proc->my_procnode = (struct sched_procnode *) malloc (sizeof (struct sched_procnode))) == NULL
+		|| (proc->sib_procnode = (struct sched_procnode *) malloc (sizeof (struct sched_procnode))) == NULL
+		|| (proc->zrec = (struct sched_zombie *) malloc (sizeof (struct sched_zombie))) == NULL
+		|| (proc->child_link = sched_plink_new (proc)) == NULL) {
+		// no memory left! cannot create child process;
+		//   release the allocated memory & clean things up
+		fprintf (stderr, "ERROR: Child process could not be created!\n");
+		fprintf (stderr, "--> malloc() failure: %s\n", strerror (errno));
+		sched_freeproc (proc);
+		return NULL;
+	}
+
+	return proc;
+}
+
+void sched_freeproc (struct sched_proc * proc) {
+	free (proc->my_procnode);
+	free (proc->sib_procnode);
+	free (proc->zrec);
+	free (proc->child_link);
+	free (proc);
+}
+
+struct sched_proc * sched_newproc (struct sched_proc * parent, struct sched_proc * child_proc, void * new_sp, struct savectx * child_ctx) {
 	// set up child_proc information
-	child_proc->task_state = SCHED_READY; // let child process be schedulable
-	child_proc->cpu_time = 0;             // it hasn't been on the cpu yet
-	child_proc->slice_max = 21;
-	child_proc->slice_acc = 0;
-	child_proc->priority = 20;            // default is 20
-	child_proc->nice = current->nice;
 	if ((child_proc->pid = sched_getunusedpid ()) == 0) {
-		// max proc limit reached! cannot create child process;
-		//   release the allocated memory & clean things up
-		fprintf (stderr, "ERORR: Child process could not be created!\n");
+		// max proc limit reached! cannot create child process
+		//   (the caller releases child_proc and the stack)
+		fprintf (stderr, "ERROR: Child process could not be created!\n");
 		fprintf (stderr, "--> Maximum process limit reached! (%d)\n", SCHED_NPROC);
-		free (child_proc);
-		munmap (new_sp, STACK_SIZE); // unmap the stack
-		if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) { // unblock signals
-			fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
-			fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
-		}
-		return -1;
+		return NULL;
 	}
-	child_proc->ppid = current->pid;                           // store current's pid as child's ppid
+	child_proc->hot = &sched_hot[child_proc->pid];             // claim the hot slot of the new pid
+	child_proc->hot->task_state = SCHED_READY;                 // let child process be schedulable
+	child_proc->hot->runtime = 0;                              // it hasn't been on the cpu yet
+	child_proc->hot->slice_max = 21;
+	child_proc->hot->slice_acc = 0;
+	child_proc->hot->sleep_avg = parent->hot->sleep_avg;       // inherit the parent's sleep credit
+	child_proc->hot->priority = 20;                            // default is 20
+	child_proc->hot->nice = parent->hot->nice;
+	child_proc->hot->group = parent->hot->group;              // inherit the parent's task group
+	child_proc->hot->proc = child_proc;
 	child_proc->exit_code = 0;                                 // exit_code is 0 for now
 	child_proc->stack_base = new_sp + STACK_SIZE;              // save pointer to TOP OF STACK (LOWER ADDRESS!)
-	child_proc->pctx = child_ctx;                              // store child context to child
-	child_proc->parent = current;                              // store pointer to current process (parent)
+	child_proc->pctx = *child_ctx;                             // store child context to child
+	child_proc->plink = parent->child_link;                    // link to the parent (referenced below)
+	child_proc->subreaper = 0;                                 // (not inherited)
 	child_proc->child_anchor.prev = &child_proc->child_anchor; // pointer to self
 	child_proc->child_anchor.next = &child_proc->child_anchor; // pointer to self
 	child_proc->child_anchor.proc = NULL;
-
-	// allocate memory for child sched_procnodes (one for proc_anchor, one for parent's child_anchor)
+	child_proc->zombies = NULL;
+	child_proc->zombies_tail = NULL;
+	child_proc->sleep_node.proc = NULL;                        // not asleep
+	child_proc->ready_since = sched_clock ();                  // READY (waiting for the cpu) from now on
+	child_proc->run_delay = 0;
+	child_proc->pcount = 0;
+	child_proc->mbox = NULL;                                   // no messages yet
+	child_proc->mbox_tail = NULL;
+	child_proc->wake_pending = 0;
+	child_proc->spawn_fn = NULL;                               // (set by sched_spawnproc)
+	child_proc->spawn_arg = NULL;
+	child_proc->timer_node.proc = NULL;                        // no timeout pending
+	child_proc->wake_tick = 0;
+
+	parent->child_link->refs += 1;
+
+	// the child's procnodes (allocated by sched_allocproc)
 	struct sched_procnode * child_procnode1, * child_procnode2;
-	if ((child_procnode1 = (struct sched_procnode *) malloc (sizeof (struct sched_procnode))) == NULL
-		|| (child_procnode2 = (struct sched_procnode *) malloc (sizeof (struct sched_procnode))) == NULL) {
-		// no memory left! cannot create child process;
-		//   release the allocated memory & clean things up
-		fprintf (stderr, "ERORR: Child process could not be created!\n");
-		fprintf (stderr, "--> malloc() failure: %s\n", strerror (errno));
-		free (child_procnode1);
-		free (child_procnode2);
-		free (child_proc);
-		munmap (new_sp, STACK_SIZE); // unmap the stack
-		if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) { // unblock signals
-			fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
-			fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
-		}
-		return -1;
-	}
-
-	// assign child's procnode pointer to the child's sched_proc "my_procnode"
-	child_proc->my_procnode = child_procnode1;
+	child_procnode1 = child_proc->my_procnode;
+	child_procnode2 = child_proc->sib_procnode;
 
 	// update proc_anchor list of living processes (insert the child to the right of the parent procnode)
-	child_procnode1->prev = current->my_procnode;       // set child's procnode's prev to the parent procnode
-	child_procnode1->next = current->my_procnode->next; // set child's procnode's next to parent's right procnode
+	child_procnode1->prev = parent->my_procnode;        // set child's procnode's prev to the parent procnode
+	child_procnode1->next = parent->my_procnode->next;  // set child's procnode's next to parent's right procnode
 	child_procnode1->next->prev = child_procnode1;      // set right node's previous to child's procnode
-	current->my_procnode->next = child_procnode1;       // set parent's next to child's procnode
+	parent->my_procnode->next = child_procnode1;        // set parent's next to child's procnode
 	child_procnode1->proc = child_proc;                 // set proc pointer to the child's sched_proc (its own)
 
 	// update the parent's list of children (insert the child at the front of the list [child_anchor])
-	child_procnode2->prev = (&current->child_anchor);   // set child's procnode's prev to the child anchor
-	child_procnode2->next = current->child_anchor.next; // set child's procnode's next to the child following it
-	current->child_anchor.next->prev = child_procnode2; // set parent's 1 child in list's previous to child procnode
-	current->child_anchor.next = child_procnode2;       // set set parent's 1 child in list to child procnode
+	child_procnode2->prev = (&parent->child_anchor);    // set child's procnode's prev to the child anchor
+	child_procnode2->next = parent->child_anchor.next;  // set child's procnode's next to the child following it
+	parent->child_anchor.next->prev = child_procnode2;  // set parent's 1 child in list's previous to child procnode
+	parent->child_anchor.next = child_procnode2;        // set set parent's 1 child in list to child procnode
 	child_procnode2->proc = child_proc;                 // pointer to the child's sched_proc (its own)
 
 	// record in pid_table that pid child_proc->pid is now in use
 	pid_table[child_proc->pid] = 1;
+	if (child_proc->pid > sched_pid_max) {
+		sched_pid_max = child_proc->pid;
+	}
+	sched_groups[child_proc->hot->group].nr_tasks += 1;
+	sched_group_enqueue (child_proc->hot->group);
+	sched_stats_ident (child_proc->pid, parent->pid, child_proc->stack_base);
+	sched_stats_update (child_proc->pid);
+
+	return child_proc;
+}
+
+int sched_spawn (void (* fn) (void *), void * arg) {
+	sigset_t block_sigset, old_sigset;
+	int pid;
+
+	// block all signals
+	sigfillset (&block_sigset);
+	if (sched_blocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+		return -1;
+	}
+
+	sched_release_dead ();
+
+	pid = sched_spawnproc (current, fn, arg, 0);
 
 	// unblock and restore signals
 	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
@@ -225,10 +413,109 @@ int sched_fork () {
 		return -1;
 	}
 
-	// return child pid to parent
+	return pid;
+}
+
+int sched_spawn_copy (void (* fn) (void *), const void * arg, size_t len) {
+	sigset_t block_sigset, old_sigset;
+	int pid;
+
+	if (len > SCHED_SPAWN_COPY_MAX) {
+		fprintf (stderr, "ERROR: Argument of %zu bytes does not fit on a new stack!\n", len);
+		fprintf (stderr, "--> sched_spawn_copy() failure\n");
+		return -1;
+	}
+
+	// block all signals
+	sigfillset (&block_sigset);
+	if (sched_blocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+		return -1;
+	}
+
+	sched_release_dead ();
+
+	pid = sched_spawnproc (current, fn, arg, len);
+
+	// unblock and restore signals
+	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+		return -1;
+	}
+
+	return pid;
+}
+
+int sched_spawnproc (struct sched_proc * parent, void (* fn) (void *), const void * arg, size_t len) {
+	// set up stack address space for the new process
+	void * new_sp;
+	if ((new_sp = mmap (0, STACK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, 0, 0)) == MAP_FAILED) {
+		fprintf (stderr, "ERROR: Child process could not be created!\n");
+		fprintf (stderr, "--> mmap() failure: %s\n", strerror (errno));
+		return -1;
+	}
+
+	struct sched_proc * child_proc;
+	int pid;
+	if ((child_proc = sched_allocproc ()) == NULL || (pid = sched_spawnat (parent, child_proc, new_sp, fn, arg, len)) < 0) {
+		if (child_proc != NULL) {
+			sched_freeproc (child_proc);
+		}
+		munmap (new_sp, STACK_SIZE); // unmap the stack
+		return -1;
+	}
+
+	return pid;
+}
+
+int sched_spawnat (struct sched_proc * parent, struct sched_proc * child_proc, void * new_sp,
+	void (* fn) (void *), const void * arg, size_t len) {
+	// a copied argument goes at the very top of the stack (keeping it 16-byte aligned)
+	void * top;
+	top = new_sp + STACK_SIZE;
+	if (len != 0) {
+		top -= (len + 15) & ~15UL;
+		memcpy (top, arg, len);
+		arg = top;
+	}
+
+	// it starts out at sched_spawn_entry on an empty stack (like init does at init_fn);
+	//   a NULL frame pointer ends the chain that adjstack walks if it forks
+	struct savectx spawn_ctx;
+	savectx (&spawn_ctx);
+	spawn_ctx.regs[JB_BP] = NULL;
+	spawn_ctx.regs[JB_SP] = top - sizeof (void *);
+	spawn_ctx.regs[JB_PC] = sched_spawn_entry;
+
+	if (sched_newproc (parent, child_proc, new_sp, &spawn_ctx) == NULL) {
+		return -1;
+	}
+	child_proc->spawn_fn = fn;
+	child_proc->spawn_arg = (void *) arg;
+
 	return child_proc->pid;
 }
 
+void sched_spawn_entry () {
+	sigset_t block_sigset, old_sigset;
+
+	// release a task that exited before we were first switched to
+	sched_release_dead ();
+
+	// sched_switch switched to us with all signals blocked; start out with none
+	sigfillset (&block_sigset);
+	sigemptyset (&old_sigset);
+	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+	}
+
+	current->spawn_fn (current->spawn_arg);
+	sched_exit (0);
+}
+
 void sched_exit (int code) {
 	sigset_t block_sigset, old_sigset;
 
@@ -239,33 +526,111 @@ void sched_exit (int code) {
 		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
 	}
 
+	// release the task that exited before us (we become the next one)
+	sched_release_dead ();
+
 	// if the current process is init, simply restore the global context
 	if (current->pid == 1) {
 		restorectx (&global_ctx, SCHED_INIT_RET);
 	}
 
-	// re-parent any children to current's parent (i.e., put them into the parent's children
-	//   doubly-linked list AND update their parent pointers and ppid) ONLY IF there are children
+	// our children go to the nearest subreaper among our ancestors, or else to our parent
+	struct sched_proc * parent, * heir;
+	parent = sched_parent (&current->plink);
+	heir = parent;
+	if (sched_subreapers != 0) {
+		for (heir = parent; heir->subreaper == 0 && heir->pid != 1; heir = sched_parent (&heir->plink));
+		if (heir->subreaper == 0) {
+			heir = parent;
+		}
+	}
+	if (current->subreaper) {
+		sched_subreapers -= 1;
+	}
+
+	// re-parent any children to the heir ONLY IF there are children: put them
+	//   into the heir's children doubly-linked list in one splice ...
 	if (current->child_anchor.next != &current->child_anchor) {
-		struct sched_procnode * pn;
-		for (pn = current->child_anchor.next; pn->proc != NULL; pn = pn->next) {
-			pn->proc->ppid = current->ppid;     // update children ppid to parent's pid
-			pn->proc->parent = current->parent; // update children parent pointers to parent
+		current->child_anchor.next->prev = &heir->child_anchor;
+		current->child_anchor.prev->next = heir->child_anchor.next;
+		heir->child_anchor.next->prev = current->child_anchor.prev;
+		heir->child_anchor.next = current->child_anchor.next; // put at front of heir's child list
+	}
+
+	// ... likewise hand any unreaped zombie children over to the heir (waking it up to reap them) ...
+	if (current->zombies != NULL) {
+		current->zombies_tail->next = heir->zombies;
+		if (heir->zombies == NULL) {
+			heir->zombies_tail = current->zombies_tail;
+		}
+		heir->zombies = current->zombies;
+
+		if (heir != parent) {
+			if (heir->hot->task_state == SCHED_SLEEPING) {
+				sched_wakeup (heir);
+			} else {
+				heir->wake_pending = 1;
+			}
 		}
+	}
 
-		// append child list to sibling list
-		current->child_anchor.next->prev = &current->parent->child_anchor;
-		current->child_anchor.prev->next = current->parent->child_anchor.next;
-		current->parent->child_anchor.next = current->child_anchor.next; // put at front of parent's child list
-		current->parent->child_anchor.next->prev = current->child_anchor.prev;
+	// ... and forward our link to the heir's, which updates the parent of all of
+	//   them at once (their ppid is looked up through it); the link goes away
+	//   once they have all moved on from it (or right now, if there are none)
+	current->child_link->parent = NULL;
+	if (current->child_link->refs > 1) {
+		current->child_link->fwd = heir->child_link;
+		heir->child_link->refs += 1;
+	}
+	sched_plink_put (current->child_link);
+
+	// shrink to the compact zombie record and put it on the parent's zombie list
+	//   (our reference to the parent's link passes to the record)
+	struct sched_zombie * zrec;
+	zrec = current->zrec;
+	zrec->pid = current->pid;
+	zrec->plink = current->plink;
+	zrec->exit_code = code;
+	sched_account ();                           // (charge the time up to now)
+	zrec->ru.runtime = current->hot->runtime;
+	zrec->ru.cpu_time = current->hot->runtime / SCHED_TICK_NS;
+	zrec->ru.stack_rss = sched_stackrss (current->stack_base);
+	zrec->next = parent->zombies;
+	if (parent->zombies == NULL) {
+		parent->zombies_tail = zrec;
 	}
-	current->task_state = SCHED_ZOMBIE;         // process is now a ZOMBIE!!!
+	parent->zombies = zrec;
+	sched_mem.zombies += 1;
+	sched_mem.zombie_bytes += sizeof (struct sched_zombie);
+	sched_stats_ident (zrec->pid, parent->pid, NULL);
+
+	// take the process off the living process list and out of the parent's child list
+	current->my_procnode->next->prev = current->my_procnode->prev;
+	current->my_procnode->prev->next = current->my_procnode->next;
+	current->sib_procnode->next->prev = current->sib_procnode->prev;
+	current->sib_procnode->prev->next = current->sib_procnode->next;
+
+	current->hot->task_state = SCHED_ZOMBIE;    // process is now a ZOMBIE!!!
+	current->hot->proc = NULL;                  // (the pid is freed once we are reaped)
+	sched_groups[current->hot->group].nr_tasks -= 1;
+	sched_group_dequeue (current->hot->group);
 	current->exit_code = code;                  // set exit code
-	pid_table[current->pid] = 0;                // free up pid, but keep pid info in our sched_proc
 
-	// sched_switch checks to see if zombie's parent is SLEEPING
-	//   if the parent is SLEEPING, the parent is rescheduled;
-	//   otherwise, another process is scheduled
+	// the rest of the process (stack, sched_proc, procnodes) is released
+	//   later, since we are still running on that stack (see sched_release_dead)
+	sched_dead = current;
+
+	// if the parent is SLEEPING in sched_wait, wake it up; since we are no
+	//   longer running, it preempts us (sched_switch goes straight to it)
+	//   unless wakeup preemption is disabled; a parent that is awake finds
+	//   the wakeup pending at its next sched_pause
+	if (parent->hot->task_state == SCHED_SLEEPING) {
+		sched_wakeup (parent);
+	} else {
+		parent->wake_pending = 1;
+	}
+
+	// schedule another process
 	sched_switch ();
 }
 
@@ -278,9 +643,11 @@ int sched_wait (int * exit_code) {
 		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
 		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
 	}
+
+	sched_release_dead ();
 	
 	// return if there are no children to kill at all
-	if (current->child_anchor.next == &current->child_anchor) {
+	if (current->child_anchor.next == &current->child_anchor && current->zombies == NULL) {
 		fprintf (stderr, "ERROR: Process %d has no zombie to kill!\n", current->pid);
 		fprintf (stderr, "--> sched_wait() failure\n");
 		if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
@@ -290,93 +657,136 @@ int sched_wait (int * exit_code) {
 		return -1;
 	}
 
-	int z_flag;	
-	z_flag = 0;
+	// if there are no zombies but there are children, we go to sleep and wait for zombies
+	//   (we may also be woken up for other reasons, e.g. by sched_post_wake)
+	while (current->zombies == NULL) {
+		sched_sleep ();
+	}
 
-	// check to see if there are zombie children
-	struct sched_procnode * pn;
-	for (pn = current->child_anchor.next; pn->proc != NULL; pn = pn->next) {
-		if (pn->proc->task_state == SCHED_ZOMBIE) {
-			z_flag = 1;
-			break;
-		}
+	// reap one zombie child (the order in which zombies are reaped is not defined)
+	int z_pid;
+	struct sched_zombie * z;
+	z = current->zombies;
+	current->zombies = z->next;
+	if (current->zombies == NULL) {
+		current->zombies_tail = NULL;
+	}
+	z_pid = sched_reap (z, exit_code);
+	
+	// unblock and restore signals
+	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
 	}
 
-	// if there are no zombies but there are children, we go to sleep and wait for zombies
-	if (z_flag == 0) {
-		current->task_state = SCHED_SLEEPING;    // switch to sleeping state
-		current->slice_acc = 0;                  // reset the time slice accumulator
-		if (savectx (&current->pctx) != SCHED_EXIT_RET) {
-			sched_switch ();                     // relinquish to another process
-		} else { // we have been awoken by a zombie child
-			current->task_state = SCHED_RUNNING; // switch to running state
+	// return the zombie pid
+	return z_pid;
+}
 
-			// print information about all living processes (debug)
-			sched_ps ();                         // debug info
-		}
+int sched_waitpid (unsigned int pid, int * exit_code, int flags) {
+	sigset_t block_sigset, old_sigset;
+	struct sched_zombie * z, * z_prev;
+	int rc;
+
+	// block all signals
+	sigfillset (&block_sigset);
+	if (sched_blocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
 	}
 
-	// kill the zombie children
-	int rc, z_pid;
-	struct sched_proc * sproc;
-	for (pn = current->child_anchor.next; pn->proc != NULL; pn = pn->next) {
-		if (pn->proc->task_state == SCHED_ZOMBIE) {
-			rc = pn->proc->exit_code;
-			z_pid = pn->proc->pid;
+	sched_release_dead ();
 
-			// remove child proc node from proc anchor living process list
-			pn->proc->my_procnode->next->prev = pn->proc->my_procnode->prev;
-			pn->proc->my_procnode->prev->next = pn->proc->my_procnode->next;
+	for (;;) {
+		// look for the child among our zombies
+		z_prev = NULL;
+		for (z = current->zombies; z != NULL && z->pid != pid; z = z->next) {
+			z_prev = z;
+		}
+		if (z != NULL) {
+			if (z_prev == NULL) {
+				current->zombies = z->next;
+			} else {
+				z_prev->next = z->next;
+			}
+			if (current->zombies_tail == z) {
+				current->zombies_tail = z_prev;
+			}
+			rc = sched_reap (z, exit_code);
+			break;
+		}
 
-			// remove child proc node from the child proc list
-			pn->next->prev = pn->prev;
-			pn->prev->next = pn->next;
+		// otherwise it has to be a living child of ours
+		if (pid == 0 || pid > SCHED_NPROC || sched_hot[pid].proc == NULL
+			|| sched_parent (&sched_hot[pid].proc->plink) != current) {
+			fprintf (stderr, "ERROR: Process %u is not a child of process %d!\n", pid, current->pid);
+			fprintf (stderr, "--> sched_waitpid() failure\n");
+			rc = -1;
+			break;
+		}
 
-			// free all dynamically allocated resources used by the zombie child
-			sproc = pn->proc;                                      // store the sched_proc before burning procnode
-			free (pn->proc->my_procnode);                          // incinerate the child sched_procnode (living proc list)
-			free (pn);                                             // free the sched_procnode of the child
-			munmap ((sproc->stack_base - STACK_SIZE), STACK_SIZE); // unmap the stack of the child
-			free (sproc);                                          // free the sched_proc of the child
+		if (flags & SCHED_WNOHANG) {
+			rc = 0;
+			break;
 		}
-	}
 
-	// store last zombie exit code in *exit_code (only if it is a valid pointer)
-	if (exit_code != NULL) {
-		*exit_code = rc; 
+		// sleep until a child exits (or something else wakes us) and look again
+		sched_sleep ();
 	}
-	
+
 	// unblock and restore signals
 	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
 		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
 		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
 	}
 
-	// return the last zombie pid
-	return z_pid;
+	return rc;
 }
 
+int sched_reap (struct sched_zombie * z, int * exit_code) {
+	int z_pid;
+	z_pid = z->pid;
 
-void sched_nice (signed short int niceval) {
-	if (niceval >= -20 && niceval <= 19) {
-		current->nice = niceval;
+	// store the zombie exit code in *exit_code (only if it is a valid pointer)
+	if (exit_code != NULL) {
+		*exit_code = z->exit_code;
 	}
-}
 
-unsigned int sched_getpid () {
-	return current->pid;
+	// release the hot slot and the pid, and free the zombie record (and its reference to our link)
+	sched_hot[z_pid].task_state = SCHED_UNUSED;
+	sched_hot[z_pid].proc = NULL;
+	pid_table[z_pid] = 0;
+	sched_stats_update (z_pid);
+	sched_plink_put (z->plink);
+	free (z);
+	sched_mem.zombies -= 1;
+	sched_mem.zombie_bytes -= sizeof (struct sched_zombie);
+
+	return z_pid;
 }
 
-unsigned int sched_getppid () {
-	return current->ppid;
+
+void sched_sleep () {
+	current->hot->task_state = SCHED_SLEEPING;    // switch to sleeping state
+	current->hot->slice_acc = 0;                  // reset the time slice accumulator
+	sched_group_dequeue (current->hot->group);
+	sched_sleep_enqueue (current);                // stack gets trimmed if we sleep for long
+	if (savectx (&current->pctx) == 0) {
+		sched_switch ();                          // relinquish to another process
+	}
+
+	// we are switched back to here by a sched_switch that was not called
+	//   from the tick handler, so a task that exited meanwhile can go now
+	sched_release_dead ();
 }
 
-unsigned long long sched_gettick () {
-	return current->cpu_time;
+void sched_pause () {
+	sched_pause_ticks (0);
 }
 
-void sched_ps () {
+int sched_pause_ticks (unsigned long long ticks) {
 	sigset_t block_sigset, old_sigset;
+	int rc;
 
 	// block all signals
 	sigfillset (&block_sigset);
@@ -385,105 +795,298 @@ void sched_ps () {
 		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
 	}
 
-	fprintf (stderr, "PID\tPPID\tTASK_STATE\tSTACK_BASE\tNICE\tDYN\tCPU_TIME\n");
+	// a wakeup that came while we were awake is not lost
+	rc = 1;
+	if (current->wake_pending == 0) {
+		if (ticks != 0) {
+			sched_timer_enqueue (current, sched_ticks + ticks);
+		}
+		sched_sleep ();
 
-	// print out relevant information
-	struct sched_procnode * pn;
-	for (pn = proc_anchor.next; pn->proc != NULL; pn = pn->next) {
-		fprintf (stdout, "%04d\t", pn->proc->pid);
-    fflush(stdout);
-		fprintf (stdout, "%04d\t", pn->proc->ppid);
-    fflush(stdout);
-		switch (pn->proc->task_state) {
-			case SCHED_READY:
-				fprintf (stdout, "SCHED_READY\t");
-				break;
-			case SCHED_RUNNING:
-				fprintf (stdout, "SCHED_RUNNING\t");
-				break;
-			case SCHED_SLEEPING:
-				fprintf (stdout, "SCHED_SLEEPING\t");
-				break;
-			case SCHED_ZOMBIE:
-				fprintf (stdout, "SCHED_ZOMBIE\t");
-				break;
+		// sched_timer_expire dequeues us if it was the timeout that woke us
+		if (current->timer_node.proc != NULL) {
+			sched_timer_dequeue (current);
+		} else if (ticks != 0) {
+			rc = 0;
 		}
-    fflush(stdout);
-		fprintf (stdout, "%x\t", pn->proc->stack_base);
-    fflush(stdout);
-		fprintf (stdout, "%d\t", pn->proc->nice);
-    fflush(stdout);
-		fprintf (stdout, "%d\t", pn->proc->priority);
-    fflush(stdout);
-		fprintf (stdout, "%llu\n", pn->proc->cpu_time);
-    fflush(stdout);
 	}
-	
+	current->wake_pending = 0;
+
 	// unblock and restore signals
 	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
 		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
 		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
 	}
+
+	return rc;
 }
 
-int sched_switch () {
+void sched_nice (signed short int niceval) {
+	if (niceval >= -20 && niceval <= 19) {
+		current->hot->nice = niceval;
+	}
+}
+
+unsigned int sched_getpid () {
+	return current->pid;
+}
+
+unsigned int sched_getppid () {
 	sigset_t block_sigset, old_sigset;
+	unsigned int ppid;
 
-	// block all signals
+	// block all signals (looking the parent up may shorten the chain of links)
 	sigfillset (&block_sigset);
 	if (sched_blocksigs (&block_sigset, &old_sigset) < 0) {
 		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
 		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
-		return -1;
 	}
 
-	// if current process is ZOMBIE and its parent is SLEEPING, wake the parent
-	if (current->task_state == SCHED_ZOMBIE && current->parent->task_state == SCHED_SLEEPING) {
-		printf ("\nContext switch from %d to ", current->pid); // debug info
-		current = current->parent;                             // make parent the current process
-		printf ("%d (waking up parent)\n", current->pid);      // debug info
-		restorectx (&current->pctx, SCHED_EXIT_RET);
-	}
+	ppid = sched_parent (&current->plink)->pid;
 
-	current->slice_max = 0; // slice_max = 0 implies current process has recently finished running
-	current->slice_acc = 0; // reset the current process time slice accumulator
+	// unblock and restore signals
+	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+	}
 
-	int cycle_flag;
-	cycle_flag = 1;
-	struct sched_procnode * pn;
+	return ppid;
+}
 
-	// update all priorities based on nice values
-	//   and check to see if there are any READY processes that have not yet run
+void sched_set_subreaper (int on) {
+	sigset_t block_sigset, old_sigset;
+
+	// block all signals
+	sigfillset (&block_sigset);
+	if (sched_blocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+	}
+
+	// (sched_exit only looks for subreapers while there are any)
+	if (on && current->subreaper == 0) {
+		current->subreaper = 1;
+		sched_subreapers += 1;
+	} else if (on == 0 && current->subreaper) {
+		current->subreaper = 0;
+		sched_subreapers -= 1;
+	}
+
+	// unblock and restore signals
+	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+	}
+}
+
+struct sched_proc * sched_parent (struct sched_plink ** link) {
+	struct sched_plink * l, * next, * root;
+
+	// the common case: the parent is alive
+	l = *link;
+	if (l->parent != NULL) {
+		return l->parent;
+	}
+
+	// find the link of the living process at the end of the chain
+	for (root = l->fwd; root->parent == NULL; root = root->fwd);
+
+	// point *link straight at it; the reference *link had on l becomes ours,
+	//   and is handed down the chain as we go
+	root->refs += 1;
+	*link = root;
+	while (l != root) {
+		next = l->fwd;
+		if (--l->refs == 0) {
+			free (l);                 // (its reference on next becomes ours)
+		} else {
+			root->refs += 1;          // others still use l: point it at root as well
+			l->fwd = root;            //   (its reference on next becomes ours)
+		}
+		l = next;
+	}
+	root->refs -= 1;                  // (root is held by its process, so it stays)
+
+	return root->parent;
+}
+
+struct sched_plink * sched_plink_new (struct sched_proc * proc) {
+	struct sched_plink * link;
+
+	if ((link = (struct sched_plink *) malloc (sizeof (struct sched_plink))) == NULL) {
+		return NULL;
+	}
+	link->parent = proc;
+	link->fwd = NULL;
+	link->refs = 1;
+
+	return link;
+}
+
+void sched_plink_put (struct sched_plink * link) {
+	struct sched_plink * fwd;
+
+	// a forwarded link holds a reference on the one it forwards to
+	while (link != NULL && --link->refs == 0) {
+		fwd = link->fwd;
+		free (link);
+		link = fwd;
+	}
+}
+
+unsigned long long sched_gettick () {
+	unsigned long long start, runtime, now;
+
+	// the time since we were last charged counts as well; retry if a tick
+	//   charged us in the meantime (it restarts sched_run_start)
+	do {
+		start = sched_run_start;
+		runtime = current->hot->runtime;
+		now = sched_clock ();
+	} while (start != sched_run_start);
+
+	return (runtime + (now - start)) / SCHED_TICK_NS;
+}
+
+// 1 while sched_ps runs for sched_ps_abort (only then is the stack RSS sampled)
+static int sched_ps_rss;
+
+void sched_ps () {
+	sigset_t block_sigset, old_sigset;
+
+	// block all signals
+	sigfillset (&block_sigset);
+	if (sched_blocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+	}
+
+	fprintf (stdout, "PID\tPPID\tTASK_STATE\tSTACK_BASE\tNICE\tDYN\tGROUP\tCPU_TIME\tRSS\tDELAY\n");
+
+	// print out relevant information (one row per process)
+	struct sched_procnode * pn;
+	struct sched_proc * proc;
+	struct sched_zombie * z;
+	const char * state;
 	for (pn = proc_anchor.next; pn->proc != NULL; pn = pn->next) {
-		pn->proc->priority = 19 - pn->proc->nice;
+		proc = pn->proc;
+		switch (proc->hot->task_state) {
+			case SCHED_READY:
+				state = "SCHED_READY";
+				break;
+			case SCHED_RUNNING:
+				state = "SCHED_RUNNING";
+				break;
+			case SCHED_SLEEPING:
+				state = "SCHED_SLEEPING";
+				break;
+			default:
+				state = "SCHED_ZOMBIE";
+				break;
+		}
+		fprintf (stdout, "%04d\t%04d\t%s\t%p\t%d\t%d\t%d\t%llu\t",
+			proc->pid, sched_parent (&proc->plink)->pid, state, proc->stack_base, proc->hot->nice, proc->hot->priority,
+			proc->hot->group, proc->hot->runtime / SCHED_TICK_NS);
+		if (sched_ps_rss) {
+			fprintf (stdout, "%lluK", sched_stackrss (proc->stack_base) >> 10); // (one mincore call per process)
+		} else {
+			fprintf (stdout, "-");
+		}
+		fprintf (stdout, "\t%lluus\n", proc->pcount == 0 ? 0 : proc->run_delay / proc->pcount / 1000);
 
-		if (pn->proc->task_state == SCHED_READY && pn->proc->slice_max != 0) {
-			cycle_flag = 0;
+		// zombie children are only compact records (no stack, no sched_proc)
+		for (z = proc->zombies; z != NULL; z = z->next) {
+			fprintf (stdout, "%04d\t%04d\tSCHED_ZOMBIE\t-\t-\t-\t-\t%llu\t%lluK\t-\n", z->pid, sched_parent (&z->plink)->pid, z->ru.cpu_time, z->ru.stack_rss >> 10);
 		}
 	}
+	fflush (stdout);
+	
+	// unblock and restore signals
+	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+	}
+}
+
+void sched_ps_abort () {
+	sched_ps_rss = 1;
+	sched_ps ();
+	sched_ps_rss = 0;
+}
+
+int sched_switch () {
+	sigset_t block_sigset, old_sigset;
+
+	// block all signals
+	sigfillset (&block_sigset);
+	if (sched_blocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+		return -1;
+	}
+
+	sched_account ();            // charge the current process for the time it has just run
+	current->hot->slice_max = 0; // slice_max = 0 implies current process has recently finished running
+	current->hot->slice_acc = 0; // reset the current process time slice accumulator
+
+	// take in what other threads have posted (new processes, wakeups, messages)
+	sched_inbox_drain ();
+
+	struct sched_hot * h, * h_end;
+	h_end = &sched_hot[sched_pid_max + 1];
+	struct sched_group * g;
+	unsigned int nr_sleeping;
+	unsigned short int prio;
+	nr_sleeping = 0;
+
+	// clear the per-switch scratch state of every group
+	for (g = &sched_groups[0]; g < &sched_groups[SCHED_NGROUP]; ++g) {
+		g->unrun = 0;
+		g->best = NULL;
+	}
 
-	// if all the READY processes have run, we update all slice_max values;
-	//   otherwise, we only update slice_max values for those processes that haven't run
-	if (cycle_flag == 1) {
-		for (pn = proc_anchor.next; pn->proc != NULL; pn = pn->next) {
-			pn->proc->slice_max = pn->proc->priority + 1;
+	// update all priorities based on nice values
+	//   and check to see which groups have READY processes that have not yet run
+	//   (these scans only touch the sched_hot array, never the cold sched_procs)
+	for (h = &sched_hot[1]; h < h_end; ++h) {
+		if (h->task_state == SCHED_UNUSED) continue;
+
+		prio = sched_effprio (h);
+		if (prio != h->priority) {
+			h->priority = prio;
+			sched_stats_update (h - sched_hot);    // (only rows that change are published)
 		}
-	} else {
-		for (pn = proc_anchor.next; pn->proc != NULL; pn = pn->next) {
-			if (pn->proc->slice_max != 0) {
-				pn->proc->slice_max = pn->proc->priority + 1;
-			}
+
+		if (h->task_state == SCHED_READY && h->slice_max != 0) {
+			sched_groups[h->group].unrun = 1;
+		} else if (h->task_state == SCHED_SLEEPING) {
+			nr_sleeping += 1;
+		}
+	}
+
+	// if all the READY processes of a group have run, we update all of its slice_max values;
+	//   otherwise, we only update slice_max values for those of its processes that haven't run
+	for (h = &sched_hot[1]; h < h_end; ++h) {
+		if (h->task_state == SCHED_UNUSED) continue;
+
+		if (sched_groups[h->group].unrun == 0 || h->slice_max != 0) {
+			h->slice_max = h->priority + 1;
 		}
 	}
 
-	int ret_flag, best_priority;
+	int ret_flag;
 	ret_flag = 0;
-	best_priority = -1;
-	struct sched_proc * best_proc;
-	best_proc = NULL;
+	struct sched_hot * best_hot;
+	best_hot = NULL;
+
+	// a process that is put back on the run queue starts waiting for the cpu now
+	if (current->hot->task_state == SCHED_READY) {
+		current->ready_since = sched_clock ();
+	}
 
-	// do not save the context of a SLEEPING process again (already saved in sched_wait)
-	if (current->task_state != SCHED_SLEEPING) {
+	// do not save the context of a SLEEPING process again (already saved in sched_sleep),
+	//   nor that of a ZOMBIE (it never runs again)
+	if (current->hot->task_state != SCHED_SLEEPING && current->hot->task_state != SCHED_ZOMBIE) {
 		if (savectx (&current->pctx) == SCHED_SWITCH_RET) {
 			ret_flag = 1;
 		}
@@ -491,28 +1094,91 @@ int sched_switch () {
 	
 	// the new process has not yet been scheduled; we schedule it here
 	if (ret_flag == 0) {
-		// loop through and find best READY process to run
-		for (pn = proc_anchor.next; pn->proc != NULL; pn = pn->next) {
+repick:
+		// a woken process that is to preempt the current one goes first,
+		//   unless its group has been throttled in the meantime
+		if (sched_wakee != NULL && sched_wakee->hot->task_state == SCHED_READY
+			&& sched_group_throttled (sched_wakee->hot->group) == 0) {
+			best_hot = sched_wakee->hot;
+		}
+		sched_wakee = NULL;
+
+		// loop through and find the best READY process of each group
+		for (h = &sched_hot[1]; h < h_end; ++h) {
 			// if the process is READY to be scheduled,
-			// and the process has a greater priority than the best one so far,
-			// and the process has not run recently, update the best parameters
-			if (pn->proc->task_state == SCHED_READY	&& pn->proc->priority > best_priority && pn->proc->slice_max != 0) {
-				best_priority = pn->proc->priority;
-				best_proc = pn->proc;
+			// and the process has a greater priority than the best one of its group so far,
+			// and the process has not run recently, update the best of its group
+			if (h->task_state == SCHED_READY && h->slice_max != 0) {
+				g = &sched_groups[h->group];
+				if (g->best == NULL || h->priority > g->best->priority) {
+					g->best = h;
+				}
 			}
 		}
 
-		// if the best_proc is NULL, we know that there are no READY processes
-		if (best_proc == NULL) {
+		// choose a group and then its best process (unless a woken process goes first)
+		if (best_hot == NULL) {
+			best_hot = sched_group_pick ();
+		}
+
+		// if every group with READY processes is throttled, idle until the
+		//   earliest of their periods ends or of the sched_pause_ticks
+		//   timeouts is reached (no ticks pass while nothing runs)
+		if (best_hot == NULL) {
+			unsigned long long next_period;
+			next_period = 0;
+			for (g = &sched_groups[0]; g < &sched_groups[SCHED_NGROUP]; ++g) {
+				if (g->in_use == 0 || (g->nr_queued == 0 && g->queued_head == NULL)) continue;
+
+				sched_group_refresh (g);
+				if (g->throttled && (next_period == 0 || g->period_start + g->period < next_period)) {
+					next_period = g->period_start + g->period;
+				}
+			}
+			if (timer_anchor.next->proc != NULL
+				&& (next_period == 0 || timer_anchor.next->proc->wake_tick < next_period)) {
+				sched_ticks = timer_anchor.next->proc->wake_tick;
+				sched_timer_expire ();
+				goto repick;
+			}
+			if (next_period != 0) {
+				sched_ticks = next_period;
+				goto repick;
+			}
+		}
+
+		// if nothing is READY but some process sleeps, only another thread can
+		//   wake it up; block until something is posted to the inbox and look again
+		//   (unless no thread posts at all)
+		if (best_hot == NULL && nr_sleeping != 0 && sched_inbox_idle () == 0) {
+			sched_inbox_drain ();
+			h_end = &sched_hot[sched_pid_max + 1];
+			goto repick;
+		}
+
+		// if the best_hot is NULL, we know that there are no READY processes
+		if (best_hot == NULL) {
 			fprintf (stderr, "FATAL: No processes are available for scheduling! Aborting...\n");
 			exit (-1);
 		}
 		
 		// we have found the process to be scheduled; let's switch to it
 		printf ("\nContext switch from %d to ", current->pid); // debug info
-		current = best_proc;
-		current->task_state = SCHED_RUNNING;
+		struct sched_proc * prev;
+		prev = current;
+		current = best_hot->proc;
+		current->hot->task_state = SCHED_RUNNING;
 		printf ("%d\n", current->pid);                         // debug info
+
+		// account for the time the process has been waiting for the cpu
+		current->run_delay += sched_clock () - current->ready_since;
+		current->pcount += 1;
+
+		// let schedtop and the like see the switch
+		sched_stats_publish (prev);
+
+		// the process is on the cpu from now on
+		sched_run_start = sched_clock ();
 		
 		// print information about all living processes (debug)
 		sched_ps ();                                           // debug info
@@ -529,14 +1195,43 @@ int sched_switch () {
 }
 
 void sched_tick () {
+	sched_ticks += 1;
+
+	// trim the stacks of processes that have been asleep for long enough
+	//   (the queue is ordered by sleep_start, so only its head needs a look)
+	while (sched_trim_ticks != 0 && sleep_anchor.next->proc != NULL
+		&& sched_ticks - sleep_anchor.next->proc->sleep_start >= sched_trim_ticks) {
+		struct sched_proc * sleeper;
+		sleeper = sleep_anchor.next->proc;
+		sched_sleep_dequeue (sleeper);
+		sched_trim (sleeper);
+	}
+
+	// wake up the processes whose sched_pause_ticks has timed out, and take in
+	//   what other threads have posted (a wakeup may preempt us below)
+	sched_timer_expire ();
+	sched_inbox_drain ();
+
 	// only tick running processes
-	if (current->task_state == SCHED_RUNNING) {
-		if (current->slice_acc < current->slice_max) {
-			current->cpu_time += 1;            // increment the cpu time
-			current->slice_acc += 1;           // increment the time slice accumulator
+	if (current->hot->task_state == SCHED_RUNNING) {
+		// a woken process is waiting to preempt us (need_resched)
+		if (sched_wakee != NULL) {
+			current->hot->task_state = SCHED_READY;
+			sched_switch ();
 		} else {
-			current->task_state = SCHED_READY; // make process READY instead of RUNNING
-			sched_switch ();                   // switch to new process
+			// charge the time run since the switch (or the last tick);
+			//   give up the cpu if the group ran out of quota or the slice is used up
+			int throttled;
+			throttled = sched_account ();
+			if (current->hot->sleep_avg > 0) {
+				current->hot->sleep_avg -= 1;       // running uses up sleep credit
+			}
+			sched_stats_tick ();
+
+			if (throttled || current->hot->slice_acc >= current->hot->slice_max * SCHED_TICK_NS) {
+				current->hot->task_state = SCHED_READY; // make process READY instead of RUNNING
+				sched_switch ();                        // switch to new process
+			}
 		}
 	}
 }
@@ -575,3 +1270,615 @@ unsigned short int sched_getunusedpid () {
 	// if we are here, no pids remain
 	return 0;
 }
+
+int sched_group_create (unsigned int parent, unsigned int shares) {
+	sigset_t block_sigset, old_sigset;
+	int gid;
+
+	if (parent >= SCHED_NGROUP || sched_groups[parent].in_use == 0) {
+		fprintf (stderr, "ERROR: Group %u does not exist!\n", parent);
+		fprintf (stderr, "--> sched_group_create() failure\n");
+		return -1;
+	}
+
+	// block all signals (sched_switch reads the group tree)
+	sigfillset (&block_sigset);
+	if (sched_blocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+		return -1;
+	}
+
+	// find a free gid
+	for (gid = 1; gid < SCHED_NGROUP; ++gid) {
+		if (sched_groups[gid].in_use == 0) break;
+	}
+
+	if (gid == SCHED_NGROUP) {
+		fprintf (stderr, "ERROR: Group could not be created!\n");
+		fprintf (stderr, "--> Maximum group limit reached! (%d)\n", SCHED_NGROUP);
+		gid = -1;
+	} else {
+		struct sched_group * g, * sib;
+		g = &sched_groups[gid];
+		memset (g, 0, sizeof (struct sched_group));
+		g->in_use = 1;
+		g->parent = parent;
+		g->shares = shares < SCHED_SHARES_MIN ? SCHED_SHARES_MIN : shares > SCHED_SHARES_MAX ? SCHED_SHARES_MAX : shares;
+
+		// start at the smallest vruntime among the new siblings, so that the
+		//   new group neither starves them nor gets starved itself
+		g->vruntime = sched_groups[parent].nr_tasks ? sched_groups[parent].self_vruntime : ~0ULL;
+		for (sib = &sched_groups[1]; sib < &sched_groups[SCHED_NGROUP]; ++sib) {
+			if (sib != g && sib->in_use && sib->parent == parent && sib->vruntime < g->vruntime) {
+				g->vruntime = sib->vruntime;
+			}
+		}
+		if (g->vruntime == ~0ULL) {
+			g->vruntime = 0;
+		}
+
+		sched_groups[parent].nr_children += 1;
+	}
+
+	// unblock and restore signals
+	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+	}
+
+	return gid;
+}
+
+int sched_group_destroy (unsigned int gid) {
+	sigset_t block_sigset, old_sigset;
+	int rc;
+
+	if (gid == 0 || gid >= SCHED_NGROUP || sched_groups[gid].in_use == 0) {
+		fprintf (stderr, "ERROR: Group %u cannot be destroyed!\n", gid);
+		fprintf (stderr, "--> sched_group_destroy() failure\n");
+		return -1;
+	}
+
+	// block all signals (sched_switch reads the group tree)
+	sigfillset (&block_sigset);
+	if (sched_blocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+		return -1;
+	}
+
+	if (sched_groups[gid].nr_tasks != 0 || sched_groups[gid].nr_children != 0) {
+		fprintf (stderr, "ERROR: Group %u is not empty!\n", gid);
+		fprintf (stderr, "--> sched_group_destroy() failure\n");
+		rc = -1;
+	} else {
+		sched_groups[sched_groups[gid].parent].nr_children -= 1;
+		sched_groups[gid].in_use = 0;
+		rc = 0;
+	}
+
+	// unblock and restore signals
+	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+	}
+
+	return rc;
+}
+
+int sched_group_setbw (unsigned int gid, unsigned long long quota, unsigned long long period) {
+	sigset_t block_sigset, old_sigset;
+
+	if (gid >= SCHED_NGROUP || sched_groups[gid].in_use == 0 || (quota != 0 && period == 0)) {
+		fprintf (stderr, "ERROR: Bandwidth of group %u could not be set!\n", gid);
+		fprintf (stderr, "--> sched_group_setbw() failure\n");
+		return -1;
+	}
+
+	// block all signals (sched_tick charges the group)
+	sigfillset (&block_sigset);
+	if (sched_blocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+		return -1;
+	}
+
+	// start a fresh period with the new limits
+	sched_groups[gid].quota = quota;
+	sched_groups[gid].period = quota != 0 ? period : 0;
+	sched_groups[gid].period_start = sched_ticks;
+	sched_groups[gid].runtime = 0;
+	sched_groups[gid].throttled = 0;
+
+	// unblock and restore signals
+	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+	}
+
+	return 0;
+}
+
+int sched_group_join (unsigned int gid) {
+	sigset_t block_sigset, old_sigset;
+
+	if (gid >= SCHED_NGROUP || sched_groups[gid].in_use == 0) {
+		fprintf (stderr, "ERROR: Group %u does not exist!\n", gid);
+		fprintf (stderr, "--> sched_group_join() failure\n");
+		return -1;
+	}
+
+	// block all signals
+	sigfillset (&block_sigset);
+	if (sched_blocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+		return -1;
+	}
+
+	sched_groups[current->hot->group].nr_tasks -= 1;
+	sched_group_dequeue (current->hot->group);
+	sched_groups[gid].nr_tasks += 1;
+	sched_group_enqueue (gid);
+	current->hot->group = gid;
+
+	// unblock and restore signals
+	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+	}
+
+	return 0;
+}
+
+unsigned int sched_getgroup () {
+	return current->hot->group;
+}
+
+void sched_group_refresh (struct sched_group * g) {
+	if (g->period != 0 && sched_ticks - g->period_start >= g->period) {
+		g->period_start += (sched_ticks - g->period_start) / g->period * g->period;
+		g->runtime = 0;
+		g->throttled = 0;
+	}
+}
+
+int sched_group_charge (unsigned int gid, unsigned long long ns) {
+	int throttled;
+	struct sched_group * g;
+
+	throttled = 0;
+	g = &sched_groups[gid];
+
+	// the directly attached processes are weighted like a group with default shares
+	g->self_vruntime += ns;
+
+	// charge the group and every ancestor (the depth of the tree, not the number of processes)
+	for (;;) {
+		sched_group_refresh (g);
+		g->vruntime += ns * SCHED_SHARES_DEFAULT / g->shares;
+		g->runtime += ns;
+		if (g->quota != 0 && g->runtime >= g->quota * SCHED_TICK_NS) {
+			g->throttled = 1;
+		}
+		throttled |= g->throttled;
+
+		if (g == &sched_groups[0]) break;
+		g = &sched_groups[g->parent];
+	}
+
+	return throttled;
+}
+
+int sched_group_throttled (unsigned int gid) {
+	struct sched_group * g;
+
+	// the group is throttled if it or any of its ancestors is
+	for (g = &sched_groups[gid]; ; g = &sched_groups[g->parent]) {
+		sched_group_refresh (g);
+		if (g->throttled) return 1;
+		if (g == &sched_groups[0]) break;
+	}
+
+	return 0;
+}
+
+void sched_group_enqueue (unsigned int gid) {
+	struct sched_group * g, * parent, * sib;
+	unsigned long long floor;
+	int was_empty;
+
+	g = &sched_groups[gid];
+	was_empty = g->nr_queued == 0 && g->queued_head == NULL;
+	g->nr_queued += 1;
+
+	// a subtree that had nothing to run joins the list of its parent (which
+	//   may make the subtree of the parent go from empty to queued in turn)
+	while (was_empty && g != &sched_groups[0]) {
+		parent = &sched_groups[g->parent];
+		was_empty = parent->nr_queued == 0 && parent->queued_head == NULL;
+
+		// the group comes back with the vruntime it had when it went idle; start
+		//   it no lower than the groups and processes it now competes with (as
+		//   sched_group_create does), so that it cannot starve them to catch up
+		//   (a group that is only throttled stays queued and keeps its vruntime)
+		floor = parent->nr_queued != 0 ? parent->self_vruntime : ~0ULL;
+		for (sib = parent->queued_head; sib != NULL; sib = sib->queued_next) {
+			if (sib->vruntime < floor) {
+				floor = sib->vruntime;
+			}
+		}
+		if (floor != ~0ULL && g->vruntime < floor) {
+			g->vruntime = floor;
+		}
+
+		g->queued_prev = NULL;
+		g->queued_next = parent->queued_head;
+		if (parent->queued_head != NULL) {
+			parent->queued_head->queued_prev = g;
+		}
+		parent->queued_head = g;
+
+		g = parent;
+	}
+}
+
+void sched_group_dequeue (unsigned int gid) {
+	struct sched_group * g, * parent;
+
+	g = &sched_groups[gid];
+	g->nr_queued -= 1;
+
+	// a subtree that has nothing to run any more leaves the list of its parent
+	while (g->nr_queued == 0 && g->queued_head == NULL && g != &sched_groups[0]) {
+		parent = &sched_groups[g->parent];
+		if (g->queued_prev != NULL) {
+			g->queued_prev->queued_next = g->queued_next;
+		} else {
+			parent->queued_head = g->queued_next;
+		}
+		if (g->queued_next != NULL) {
+			g->queued_next->queued_prev = g->queued_prev;
+		}
+
+		g = parent;
+	}
+}
+
+struct sched_hot * sched_group_pick () {
+	struct sched_group * g, * c, * best_child;
+
+	for (g = &sched_groups[0]; g < &sched_groups[SCHED_NGROUP]; ++g) {
+		g->blocked = 0;
+	}
+
+	for (;;) {
+		g = &sched_groups[0];
+		sched_group_refresh (g);
+		if (g->throttled || g->blocked) {
+			return NULL;
+		}
+
+		// walk down the queued groups; at every level the directly attached processes
+		//   compete as one entity with the child groups, by least vruntime
+		for (;;) {
+			best_child = NULL;
+			for (c = g->queued_head; c != NULL; c = c->queued_next) {
+				if (c->blocked) continue;
+
+				sched_group_refresh (c);
+				if (c->throttled) continue;
+
+				if (best_child == NULL || c->vruntime < best_child->vruntime) {
+					best_child = c;
+				}
+			}
+
+			if (best_child == NULL || (g->best != NULL && g->self_vruntime <= best_child->vruntime)) break;
+
+			g = best_child;
+		}
+
+		if (g->best != NULL) {
+			return g->best;
+		}
+
+		// everything below g is throttled (or not READY yet): pass it over and walk again
+		g->blocked = 1;
+	}
+}
+
+void sched_release_dead () {
+	struct sched_proc * dead;
+
+	// messages taken off the inbox in the tick handler are freed here, too
+	sched_inbox_reclaim ();
+
+	if ((dead = sched_dead) == NULL) return;
+	sched_dead = NULL;
+
+	// the zombie record lives on; everything else of the dead process goes
+	if (dead->stack_base != NULL) {
+		munmap ((dead->stack_base - STACK_SIZE), STACK_SIZE); // unmap the stack
+		sched_mem.stack_released += STACK_SIZE;
+	}
+	sched_mbox_free (dead);
+	free (dead->my_procnode);
+	free (dead->sib_procnode);
+	free (dead);
+}
+
+void sched_sleep_enqueue (struct sched_proc * proc) {
+	// append at the tail (the queue is ordered by sleep_start)
+	proc->sleep_start = sched_ticks;
+	proc->sleep_node.proc = proc;
+	proc->sleep_node.prev = sleep_anchor.prev;
+	proc->sleep_node.next = &sleep_anchor;
+	sleep_anchor.prev->next = &proc->sleep_node;
+	sleep_anchor.prev = &proc->sleep_node;
+}
+
+void sched_sleep_dequeue (struct sched_proc * proc) {
+	// only unlink if still queued (trimmed sleepers have already left the queue)
+	if (proc->sleep_node.proc != NULL) {
+		proc->sleep_node.next->prev = proc->sleep_node.prev;
+		proc->sleep_node.prev->next = proc->sleep_node.next;
+		proc->sleep_node.proc = NULL;
+	}
+}
+
+void sched_timer_enqueue (struct sched_proc * proc, unsigned long long tick) {
+	struct sched_procnode * pn;
+
+	// insert in wake_tick order (searching from the tail, where later timeouts go)
+	for (pn = timer_anchor.prev; pn->proc != NULL && pn->proc->wake_tick > tick; pn = pn->prev);
+	proc->wake_tick = tick;
+	proc->timer_node.proc = proc;
+	proc->timer_node.prev = pn;
+	proc->timer_node.next = pn->next;
+	pn->next->prev = &proc->timer_node;
+	pn->next = &proc->timer_node;
+}
+
+void sched_timer_dequeue (struct sched_proc * proc) {
+	if (proc->timer_node.proc != NULL) {
+		proc->timer_node.next->prev = proc->timer_node.prev;
+		proc->timer_node.prev->next = proc->timer_node.next;
+		proc->timer_node.proc = NULL;
+		proc->wake_tick = 0;
+	}
+}
+
+void sched_timer_expire () {
+	struct sched_proc * proc;
+
+	// the queue is ordered by wake_tick, so only its head needs a look
+	while ((proc = timer_anchor.next->proc) != NULL && proc->wake_tick <= sched_ticks) {
+		sched_timer_dequeue (proc);
+		sched_wakeup (proc);
+	}
+}
+
+void sched_trim (struct sched_proc * proc) {
+	unsigned long stack_lo, stack_sp, page_size;
+	unsigned long long rss_before;
+
+	if (proc->stack_base == NULL) return;
+
+	// everything below the saved stack pointer (and its red zone) is unused
+	page_size = sysconf (_SC_PAGESIZE);
+	stack_lo = (unsigned long) proc->stack_base - STACK_SIZE;
+	stack_sp = ((unsigned long) proc->pctx.regs[JB_SP] - SCHED_CKPT_REDZONE) & ~(page_size - 1);
+	if (stack_sp <= stack_lo) return;
+
+	rss_before = sched_stackrss (proc->stack_base);
+	if (madvise ((void *) stack_lo, stack_sp - stack_lo, MADV_DONTNEED) < 0) {
+		fprintf (stderr, "ERROR: Stack of process %d could not be trimmed!\n", proc->pid);
+		fprintf (stderr, "--> madvise() failure: %s\n", strerror (errno));
+		return;
+	}
+	sched_mem.stack_trimmed += rss_before - sched_stackrss (proc->stack_base);
+}
+
+void sched_settrim (unsigned long long ticks) {
+	sched_trim_ticks = ticks;
+}
+
+unsigned long long sched_stackrss (void * stack_base) {
+	unsigned char vec[STACK_SIZE / 4096];
+	unsigned long long rss;
+	long page_size;
+	int i, npages;
+
+	if (stack_base == NULL) return 0;
+
+	page_size = sysconf (_SC_PAGESIZE);
+	npages = STACK_SIZE / page_size;
+	if (npages > sizeof (vec) || mincore (stack_base - STACK_SIZE, STACK_SIZE, vec) < 0) {
+		return 0;
+	}
+
+	rss = 0;
+	for (i = 0; i < npages; ++i) {
+		rss += (vec[i] & 1) ? page_size : 0;
+	}
+
+	return rss;
+}
+
+unsigned long long sched_getrss (unsigned int pid) {
+	if (pid == 0 || pid > SCHED_NPROC || sched_hot[pid].proc == NULL) {
+		return 0;
+	}
+
+	return sched_stackrss (sched_hot[pid].proc->stack_base);
+}
+
+int sched_memstat (struct sched_memstat * ms) {
+	sigset_t block_sigset, old_sigset;
+	struct sched_procnode * pn;
+
+	if (ms == NULL) return -1;
+
+	// block all signals (the process list must not change under us)
+	sigfillset (&block_sigset);
+	if (sched_blocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+		return -1;
+	}
+
+	*ms = sched_mem;
+	ms->stack_mapped = 0;
+	ms->stack_resident = 0;
+	for (pn = proc_anchor.next; pn->proc != NULL; pn = pn->next) {
+		if (pn->proc->stack_base != NULL) {
+			ms->stack_mapped += STACK_SIZE;
+			ms->stack_resident += sched_stackrss (pn->proc->stack_base);
+		}
+	}
+
+	// the task that exited last keeps its stack until it is released
+	if (sched_dead != NULL && sched_dead->stack_base != NULL) {
+		ms->stack_mapped += STACK_SIZE;
+		ms->stack_resident += sched_stackrss (sched_dead->stack_base);
+	}
+
+	// unblock and restore signals
+	if (sched_unblocksigs (&block_sigset, &old_sigset) < 0) {
+		fprintf (stderr, "ERROR: Process signal mask for process %d could not be restored!\n", current->pid);
+		fprintf (stderr, "--> sigprocmask() failure: %s\n", strerror (errno));
+	}
+
+	return 0;
+}
+
+unsigned long long sched_clock () {
+	struct timespec ts;
+
+#if defined (__x86_64__)
+	// scale the cycles since the calibration to ns (128 bits, so that long spans do not overflow)
+	if (sched_tsc_mult != 0) {
+		unsigned int aux;
+		return sched_ns_base + (unsigned long long)
+			((unsigned __int128) (__rdtscp (&aux) - sched_tsc_base) * sched_tsc_mult >> 32);
+	}
+#endif
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void sched_clock_init () {
+	sched_tsc_mult = 0;
+
+#if defined (__x86_64__)
+	// the TSC must tick at a constant rate in every power state (invariant TSC),
+	//   and rdtscp must be there (it waits for earlier instructions to finish)
+	unsigned int eax, ebx, ecx, edx;
+	if (__get_cpuid (0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007) return;
+	if (__get_cpuid (0x80000001, &eax, &ebx, &ecx, &edx) == 0 || (edx & (1 << 27)) == 0) return;
+	if (__get_cpuid (0x80000007, &eax, &ebx, &ecx, &edx) == 0 || (edx & (1 << 8)) == 0) return;
+
+	// count the cycles over SCHED_TSC_CALIBRATE ns of CLOCK_MONOTONIC
+	unsigned long long tsc0, tsc1, ns0, ns1;
+	unsigned int aux;
+	ns0 = sched_clock ();
+	tsc0 = __rdtscp (&aux);
+	do {
+		ns1 = sched_clock ();
+	} while (ns1 - ns0 < SCHED_TSC_CALIBRATE);
+	tsc1 = __rdtscp (&aux);
+	if (tsc1 <= tsc0) return;
+
+	sched_tsc_base = tsc1;
+	sched_ns_base = ns1;
+	sched_tsc_mult = ((ns1 - ns0) << 32) / (tsc1 - tsc0);
+#endif
+}
+
+int sched_account () {
+	unsigned long long now, delta;
+	struct sched_hot * h;
+
+	now = sched_clock ();
+	delta = now - sched_run_start;
+	sched_run_start = now;
+
+	h = current->hot;
+	h->runtime += delta;
+	h->slice_acc = delta >= ~0U - h->slice_acc ? ~0U : h->slice_acc + delta;
+
+	return sched_group_charge (h->group, delta);
+}
+
+unsigned short int sched_effprio (struct sched_hot * h) {
+	int prio;
+
+	// static priority, moved up (or down) by how much the process has slept
+	prio = 19 - h->nice;
+	prio += (int) (h->sleep_avg * SCHED_MAX_BONUS / SCHED_SLEEP_AVG_MAX) - SCHED_MAX_BONUS / 2;
+
+	if (prio < 0) prio = 0;
+	if (prio > 39) prio = 39;
+	return prio;
+}
+
+void sched_wakeup (struct sched_proc * proc) {
+	struct sched_hot * h;
+	unsigned long long slept;
+
+	h = proc->hot;
+	if (h->task_state != SCHED_SLEEPING) return;
+
+	// credit the ticks slept to sleep_avg (up to SCHED_SLEEP_AVG_MAX)
+	sched_sleep_dequeue (proc);
+	slept = sched_ticks - proc->sleep_start;
+	if (slept >= SCHED_SLEEP_AVG_MAX - h->sleep_avg) {
+		h->sleep_avg = SCHED_SLEEP_AVG_MAX;
+	} else {
+		h->sleep_avg += slept;
+	}
+
+	// make it READY with its new dynamic priority (and a fresh slice if it had used up its last one)
+	h->priority = sched_effprio (h);
+	if (h->slice_max == 0) {
+		h->slice_max = h->priority + 1;
+	}
+	h->task_state = SCHED_READY;
+	proc->ready_since = sched_clock ();
+	sched_group_enqueue (h->group);
+	sched_stats_update (proc->pid);
+
+	// preempt the current process if it is no longer running or if we beat it by the margin
+	if (sched_wakeup_margin < 0) return;
+	if (current->hot->task_state == SCHED_RUNNING
+		&& h->priority < sched_effprio (current->hot) + sched_wakeup_margin) return;
+
+	// (of several woken processes, the best one goes first)
+	if (sched_wakee == NULL || h->priority > sched_wakee->hot->priority) {
+		sched_wakee = proc;
+	}
+}
+
+void sched_setwakeup (int margin) {
+	sched_wakeup_margin = margin;
+}
+
+int sched_getdelay (unsigned int pid, unsigned long long * run_delay, unsigned long long * pcount) {
+	if (pid == 0 || pid > SCHED_NPROC || sched_hot[pid].proc == NULL) {
+		fprintf (stderr, "ERROR: Process %u does not exist!\n", pid);
+		fprintf (stderr, "--> sched_getdelay() failure\n");
+		return -1;
+	}
+
+	if (run_delay != NULL) {
+		*run_delay = sched_hot[pid].proc->run_delay;
+	}
+	if (pcount != NULL) {
+		*pcount = sched_hot[pid].proc->pcount;
+	}
+
+	return 0;
+}
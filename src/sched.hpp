@@ -0,0 +1,491 @@
+#ifndef __SCHED_HPP__
+#define __SCHED_HPP__
+
+// C++ front-end of the scheduler (header-only, needs C++20)
+//
+//   sched::task       handle of a child task; reaps it when destroyed
+//   sched::spawn (f)  start a child task running the callable f (small,
+//                     trivially copyable ones are copied onto the child's
+//                     stack by sched_spawn_copy (), so nothing is malloc'd)
+//   sched::job        stackless coroutine; a sched::executor runs any number
+//                     of them inside the one task that calls run (), so a
+//                     job costs a coroutine frame instead of a 64 KiB stack
+//
+//   Inside a job:
+//     co_await sched::sleep_for (ticks);      // let ticks of sched_ticks pass
+//     int code = co_await t.wait ();          // wait for a child task to exit
+//     T v = co_await ch.recv ();              // take a value from a sched::channel<T>
+//     T v = co_await sched::receive<T> ();    // take a message from the task's mailbox
+//
+//   All of this belongs to the task that created it: a task can only reap
+//   its own children, and an executor and its channels must only be used by
+//   the task that runs it.  An exception that escapes a spawned callable or
+//   a job terminates the program (as one escaping a thread would).
+
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <new>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "usched.h"
+
+namespace sched {
+
+namespace detail {
+
+// call f, and turn what it returns into an exit code (0 unless it returns something like an int)
+template <class F>
+int call (F & f) {
+	if constexpr (std::is_convertible_v<std::invoke_result_t<F &>, int>) {
+		return std::invoke (f);
+	} else {
+		std::invoke (f);
+		return 0;
+	}
+}
+
+// where a task spawned for a callable starts out: on a copy at the top of its own stack ...
+template <class F>
+void entry_copied (void * arg) noexcept {
+	sched_exit (call (*std::launder (static_cast<F *> (arg))));
+}
+
+// ... or on one that was allocated for it (and is freed before exiting)
+template <class F>
+void entry_heap (void * arg) noexcept {
+	int code;
+	{
+		std::unique_ptr<F> f (static_cast<F *> (arg));
+		code = call (*f);
+	}
+	sched_exit (code);
+}
+
+} // namespace detail
+
+class wait_child;
+
+// handle of a child task, which is reaped (with sched_waitpid ()) by
+//   join () or else when the handle is destroyed; like std::thread it can
+//   only be moved, and the task that spawned the child must do the reaping
+class task {
+public:
+	task () noexcept : pid_ (0) {}
+	explicit task (unsigned int pid) noexcept : pid_ (pid) {}   // take over a child made by sched_fork () etc.
+	task (task && other) noexcept : pid_ (std::exchange (other.pid_, 0)) {}
+	task & operator= (task && other) noexcept {
+		if (this != &other) {
+			reset ();
+			pid_ = std::exchange (other.pid_, 0);
+		}
+		return *this;
+	}
+	task (const task &) = delete;
+	task & operator= (const task &) = delete;
+	~task () { reset (); }
+
+	unsigned int pid () const noexcept { return pid_; }
+	bool joinable () const noexcept { return pid_ != 0; }
+
+	// sleep until the child exits, reap it and return its exit code
+	int join () {
+		int code;
+		if (pid_ == 0) {
+			throw std::logic_error ("sched::task::join: no child to join");
+		}
+		if (sched_waitpid (std::exchange (pid_, 0), &code, 0) < 0) {
+			throw std::runtime_error ("sched::task::join: not a child of this task");
+		}
+		return code;
+	}
+
+	// reap the child if it has exited already (storing its exit code in code)
+	bool try_join (int & code) {
+		int rc;
+		if (pid_ == 0) {
+			throw std::logic_error ("sched::task::try_join: no child to join");
+		}
+		if ((rc = sched_waitpid (pid_, &code, SCHED_WNOHANG)) < 0) {
+			pid_ = 0;
+			throw std::runtime_error ("sched::task::try_join: not a child of this task");
+		}
+		if (rc == 0) {
+			return false;
+		}
+		pid_ = 0;
+		return true;
+	}
+
+	// give up the handle without reaping (the child is left to sched_wait ())
+	unsigned int release () noexcept { return std::exchange (pid_, 0); }
+
+	// awaitable for a sched::job: co_await t.wait () gives the exit code
+	//   (the child passes to the awaiter, which reaps it in any case)
+	wait_child wait ();
+
+private:
+	void reset () noexcept {
+		if (pid_ != 0) {
+			sched_waitpid (std::exchange (pid_, 0), nullptr, 0);
+		}
+	}
+
+	unsigned int pid_;
+};
+
+// start a child task running f () and return its handle; the task exits
+//   with what f returns if that converts to int, and with 0 otherwise
+template <class F>
+task spawn (F && f) {
+	using Fn = std::decay_t<F>;
+	int pid;
+
+	if constexpr (std::is_trivially_copyable_v<Fn> && sizeof (Fn) <= SCHED_SPAWN_COPY_MAX && alignof (Fn) <= 16) {
+		Fn fn (std::forward<F> (f));
+		pid = sched_spawn_copy (&detail::entry_copied<Fn>, std::addressof (fn), sizeof (Fn));
+	} else {
+		Fn * fn = new Fn (std::forward<F> (f));
+		if ((pid = sched_spawn (&detail::entry_heap<Fn>, fn)) < 0) {
+			delete fn;
+		}
+	}
+
+	if (pid < 0) {
+		throw std::runtime_error ("sched::spawn: the task could not be created");
+	}
+	return task (pid);
+}
+
+class executor;
+
+// coroutine type of the jobs an executor runs: write a function returning
+//   sched::job that uses co_await, and hand what it returns to executor::spawn ()
+class job {
+public:
+	struct promise_type {
+		executor * ex = nullptr;
+		promise_type * prev = nullptr;          // list of the executor's unfinished jobs
+		promise_type * next = nullptr;
+
+		job get_return_object () noexcept { return job (std::coroutine_handle<promise_type>::from_promise (*this)); }
+		std::suspend_always initial_suspend () noexcept { return {}; }
+		std::suspend_always final_suspend () noexcept { return {}; }
+		void return_void () noexcept {}
+		void unhandled_exception () noexcept { std::terminate (); }
+	};
+	using handle = std::coroutine_handle<promise_type>;
+
+	job (job && other) noexcept : h_ (std::exchange (other.h_, {})) {}
+	job (const job &) = delete;
+	job & operator= (const job &) = delete;
+	~job () {
+		if (h_) {
+			h_.destroy ();                          // (never handed to an executor)
+		}
+	}
+
+private:
+	friend class executor;
+	explicit job (handle h) noexcept : h_ (h) {}
+
+	handle h_;
+};
+
+// part of an awaiter that is parked with the executor until it can go on
+struct waiter {
+	job::handle h;
+};
+
+// runs jobs inside the calling task: a job runs until it co_awaits
+//   something that is not there yet, and is resumed (round robin with the
+//   other ready jobs) once it is; while no job can go on, the task sleeps in
+//   sched_pause_ticks () until a child exits, a message arrives or the
+//   earliest sleep_for () is due
+class executor {
+public:
+	executor () = default;
+	executor (const executor &) = delete;
+	executor & operator= (const executor &) = delete;
+	// destroy the jobs that have not finished (never run, or parked); what
+	//   they hold goes with them (a sched::task they hold, or a child they
+	//   wait for, is reaped then, which may sleep until the child exits)
+	~executor () {
+		ready_.clear ();
+		timers_ = {};
+		children_.clear ();
+		mail_.clear ();
+		while (jobs_ != nullptr) {
+			job::handle h = job::handle::from_promise (*jobs_);
+			jobs_ = jobs_->next;
+			h.destroy ();
+		}
+	}
+
+	// add a job (it first runs once run () gets to it); jobs may spawn more jobs
+	void spawn (job && j) {
+		job::handle h = std::exchange (j.h_, {});
+		job::promise_type & p = h.promise ();
+		p.ex = this;
+		p.next = jobs_;
+		if (jobs_ != nullptr) {
+			jobs_->prev = &p;
+		}
+		jobs_ = &p;
+		ready_.push_back (h);
+		++live_;
+	}
+
+	// number of jobs that have not finished yet
+	std::size_t size () const noexcept { return live_; }
+
+	// run the jobs until all of them have finished
+	void run ();
+
+private:
+	friend class sleep_for;
+	friend class wait_child;
+	template <class> friend class channel;
+	template <class> friend class receive;
+
+	struct timer {
+		unsigned long long tick;                // sched_ticks value at which the job is due
+		unsigned long long seq;                 // (keeps jobs due at the same tick in order)
+		job::handle h;
+		bool operator> (const timer & other) const noexcept {
+			return tick != other.tick ? tick > other.tick : seq > other.seq;
+		}
+	};
+
+	// parked on a mailbox receive: the message is copied to buf (cap bytes)
+	struct mail_waiter : waiter {
+		void * buf;
+		std::size_t cap;
+	};
+
+	void wake (job::handle h) { ready_.push_back (h); }
+
+	// a job has finished
+	void finish (job::handle h) {
+		job::promise_type & p = h.promise ();
+		if (p.prev != nullptr) {
+			p.prev->next = p.next;
+		} else {
+			jobs_ = p.next;
+		}
+		if (p.next != nullptr) {
+			p.next->prev = p.prev;
+		}
+		h.destroy ();
+		--live_;
+	}
+
+	std::deque<job::handle> ready_;
+	std::priority_queue<timer, std::vector<timer>, std::greater<timer>> timers_;
+	std::vector<wait_child *> children_;
+	std::deque<mail_waiter *> mail_;
+	unsigned long long timer_seq_ = 0;
+	std::size_t live_ = 0;
+	job::promise_type * jobs_ = nullptr;    // unfinished jobs
+};
+
+// co_await sched::sleep_for (ticks): resume after ticks of sched_ticks
+class sleep_for {
+public:
+	explicit sleep_for (unsigned long long ticks) noexcept : ticks_ (ticks) {}
+
+	bool await_ready () const noexcept { return ticks_ == 0; }
+	void await_suspend (job::handle h) {
+		executor * ex = h.promise ().ex;
+		ex->timers_.push ({sched_ticks + ticks_, ex->timer_seq_++, h});
+	}
+	void await_resume () const noexcept {}
+
+private:
+	unsigned long long ticks_;
+};
+
+// co_await sched::wait (pid) or t.wait (): resume once the child has exited
+//   (it is reaped, and the exit code is the result); the awaiter owns the
+//   child until then, so it is reaped even if the job is destroyed first
+class wait_child : waiter {
+public:
+	explicit wait_child (unsigned int pid) noexcept : child_ (pid) {}
+	explicit wait_child (task && t) noexcept : child_ (std::move (t)) {}
+
+	bool await_ready () { return reap (); }
+	void await_suspend (job::handle h) {
+		this->h = h;
+		h.promise ().ex->children_.push_back (this);
+	}
+	int await_resume () {
+		if (rc_ < 0) {
+			throw std::runtime_error ("sched::wait: not a child of this task");
+		}
+		return code_;
+	}
+
+private:
+	friend class executor;
+
+	// reap the child if it has exited (or let go of it if it is not ours)
+	bool reap () {
+		if ((rc_ = sched_waitpid (child_.pid (), &code_, SCHED_WNOHANG)) == 0) {
+			return false;
+		}
+		child_.release ();
+		return true;
+	}
+
+	task child_;
+	int rc_ = 0;
+	int code_ = 0;
+};
+
+inline wait_child wait (unsigned int pid) noexcept { return wait_child (pid); }
+inline wait_child task::wait () { return wait_child (std::move (*this)); }
+
+// unbounded FIFO channel between the jobs of one executor; send () never
+//   blocks, and hands the value straight to the job waiting longest in recv ()
+template <class T>
+class channel {
+	struct recv_awaiter;
+
+public:
+	void send (T value) {
+		if (waiters_.empty ()) {
+			queue_.push_back (std::move (value));
+			return;
+		}
+		recv_awaiter * w = waiters_.front ();
+		waiters_.pop_front ();
+		w->value.emplace (std::move (value));
+		w->h.promise ().ex->wake (w->h);
+	}
+
+	// co_await ch.recv () gives the oldest value
+	recv_awaiter recv () noexcept { return recv_awaiter (*this); }
+
+	// number of values sent but not received yet
+	std::size_t size () const noexcept { return queue_.size (); }
+
+private:
+	struct recv_awaiter : waiter {
+		explicit recv_awaiter (channel & ch) noexcept : ch (ch) {}
+
+		bool await_ready () {
+			if (ch.queue_.empty ()) {
+				return false;
+			}
+			value.emplace (std::move (ch.queue_.front ()));
+			ch.queue_.pop_front ();
+			return true;
+		}
+		void await_suspend (job::handle h) {
+			this->h = h;
+			ch.waiters_.push_back (this);
+		}
+		T await_resume () { return std::move (*value); }
+
+		channel & ch;
+		std::optional<T> value;
+	};
+
+	std::deque<T> queue_;
+	std::deque<recv_awaiter *> waiters_;
+};
+
+// co_await sched::receive<T> (): take the oldest message out of the mailbox
+//   of the task running the executor (see sched_post_msg ()), as a T; bytes
+//   past the end of a shorter message are zero, those of a longer one are dropped
+template <class T>
+class receive : executor::mail_waiter {
+	static_assert (std::is_trivially_copyable_v<T>, "sched::receive: messages are plain bytes");
+
+public:
+	bool await_ready () const noexcept { return false; }
+
+	// take a message right away only if no job is parked on the mailbox
+	//   already (they get theirs first, in order); otherwise park
+	bool await_suspend (job::handle h) {
+		executor * ex = h.promise ().ex;
+		if (ex->mail_.empty () && sched_poll () >= 0) {
+			sched_recv (&value_, sizeof (T));
+			return false;
+		}
+		this->h = h;
+		this->buf = &value_;
+		this->cap = sizeof (T);
+		ex->mail_.push_back (this);
+		return true;
+	}
+	T await_resume () noexcept { return value_; }
+
+private:
+	T value_ {};
+};
+
+inline void executor::run () {
+	while (live_ != 0) {
+		// resume the jobs that are ready (those made ready meanwhile go next round)
+		for (std::size_t n = ready_.size (); n != 0; --n) {
+			job::handle h = ready_.front ();
+			ready_.pop_front ();
+			h.resume ();
+			if (h.done ()) {
+				finish (h);
+			}
+		}
+
+		// jobs waiting for children that have exited
+		for (std::size_t i = 0; i < children_.size (); ) {
+			wait_child * w = children_[i];
+			if (w->reap () == false) {
+				++i;
+				continue;
+			}
+			wake (w->h);
+			children_[i] = children_.back ();
+			children_.pop_back ();
+		}
+
+		// jobs waiting for messages that have arrived
+		while (mail_.empty () == false && sched_poll () >= 0) {
+			mail_waiter * w = mail_.front ();
+			mail_.pop_front ();
+			sched_recv (w->buf, w->cap);
+			wake (w->h);
+		}
+
+		// jobs whose sleep is over
+		while (timers_.empty () == false && timers_.top ().tick <= sched_ticks) {
+			wake (timers_.top ().h);
+			timers_.pop ();
+		}
+
+		if (ready_.empty () == false || live_ == 0) continue;
+
+		// nothing can go on; only a child, a message or a timeout can change that
+		if (children_.empty () && mail_.empty () && timers_.empty ()) {
+			throw std::logic_error ("sched::executor::run: every job waits on a channel nobody sends to");
+		}
+		unsigned long long now = sched_ticks;
+		if (timers_.empty ()) {
+			sched_pause_ticks (0);
+		} else if (timers_.top ().tick > now) {
+			sched_pause_ticks (timers_.top ().tick - now);
+		}
+	}
+}
+
+} // namespace sched
+
+#endif
@@ -0,0 +1,343 @@
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include "usched.h"
+
+// schedbench [-n tasks] [-r rounds]
+//   Measure the scan sched_switch () makes over all tasks (priority
+//   update, then the search for the best READY task) with a cold cache,
+//   for two layouts of the scheduling state:
+//     old  a sched_proc of the original layout per task (the scheduling
+//          fields mixed in with the 512-byte register context), malloc'd
+//          along with its procnode and reached by walking proc_anchor
+//     hot  the pid-indexed sched_hot array (32 bytes per task)
+//   and print the time and the cache misses (from perf_event_open, where
+//   the kernel allows it) per scan.  Since the counters are often not
+//   available (in containers and VMs), the time per task of the same
+//   scan repeated back to back with a warm cache is printed as well,
+//   and the size of the state per task (from sizeof, not measured).
+// schedbench -w [-r rounds]
+//   Measure the wakeup latency of the real scheduler: a task sleeps in
+//   sched_pause_ticks (1) rounds times while a task of lower priority
+//   spins, with wakeup preemption on (the default margin) and then off,
+//   and print the time it spent READY after each timeout before it got
+//   the cpu back (its run_delay, see sched_getdelay).
+//   Both are built and run by "make bench".
+
+#define BENCH_EVICT (64 << 20)           // bytes walked to flush the caches before each scan
+#define BENCH_WARM  1000                 // scans timed back to back with a warm cache
+
+// sched_proc as it was before the hot/cold split (struct savectx was JB_SIZE pointers then)
+struct bench_oldproc {
+	unsigned short int task_state;
+	unsigned long long cpu_time;
+	unsigned long long slice_max;
+	unsigned long long slice_acc;
+	unsigned short int priority;
+	signed short int nice;
+	unsigned int pid;
+	unsigned int ppid;
+	int exit_code;
+	void * stack_base;
+	void * pctx[JB_SIZE];
+	struct bench_oldproc * parent;
+	struct sched_procnode * my_procnode;
+	struct sched_procnode child_anchor;
+};
+
+static struct sched_procnode old_anchor;
+static struct sched_hot hot[SCHED_NPROC + 1] __attribute__ ((aligned (64)));
+static volatile unsigned char * evict;
+static int perf_fd[2] = { -1, -1 };      // cache misses (last level), L1 data cache read misses
+
+#define BENCH_WAKE_NICE 10               // nice value of the spinning task (its slice is 5 ticks)
+
+static int wake_rounds;
+static volatile int wake_done;           // tells the spinning task to exit
+static unsigned long long wake_avg[2], wake_max[2]; // run_delay per wakeup (ns), preemption on and off
+
+// open a counter for this thread (-1 if the kernel does not allow it)
+int bench_perf_open (unsigned int type, unsigned long long config) {
+	struct perf_event_attr attr;
+
+	memset (&attr, 0, sizeof (attr));
+	attr.size = sizeof (attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+void bench_evict () {
+	unsigned long i;
+
+	for (i = 0; i < BENCH_EVICT; i += 64) {
+		evict[i] += 1;
+	}
+}
+
+// one scan as sched_switch makes it over the old layout
+struct bench_oldproc * bench_scan_old () {
+	struct sched_procnode * pn;
+	struct bench_oldproc * p, * best;
+
+	for (pn = old_anchor.next; pn->proc != NULL; pn = pn->next) {
+		p = (struct bench_oldproc *) pn->proc;
+		p->priority = 19 - p->nice;
+		if (p->task_state == SCHED_READY && p->slice_max == 0) {
+			p->slice_max = p->priority + 1;
+		}
+	}
+
+	best = NULL;
+	for (pn = old_anchor.next; pn->proc != NULL; pn = pn->next) {
+		p = (struct bench_oldproc *) pn->proc;
+		if (p->task_state == SCHED_READY && p->slice_max != 0 && (best == NULL || p->priority > best->priority)) {
+			best = p;
+		}
+	}
+	return best;
+}
+
+// the same scan over the hot array
+struct sched_hot * bench_scan_hot (unsigned int ntasks) {
+	struct sched_hot * h, * h_end, * best;
+
+	h_end = &hot[ntasks + 1];
+	for (h = &hot[1]; h < h_end; ++h) {
+		if (h->task_state == SCHED_UNUSED) continue;
+		h->priority = 19 - h->nice;
+		if (h->task_state == SCHED_READY && h->slice_max == 0) {
+			h->slice_max = h->priority + 1;
+		}
+	}
+
+	best = NULL;
+	for (h = &hot[1]; h < h_end; ++h) {
+		if (h->task_state == SCHED_READY && h->slice_max != 0 && (best == NULL || h->priority > best->priority)) {
+			best = h;
+		}
+	}
+	return best;
+}
+
+// run rounds cold scans and BENCH_WARM warm ones of one layout and print the averages
+void bench_run (const char * name, int old, unsigned int ntasks, int rounds) {
+	unsigned long long ns, warm_ns, misses[2], count;
+	struct timespec t0, t1;
+	volatile void * sink;
+	int r, i;
+
+	ns = 0;
+	misses[0] = misses[1] = 0;
+	for (r = 0; r < rounds; ++r) {
+		bench_evict ();
+		for (i = 0; i < 2; ++i) {
+			if (perf_fd[i] >= 0) {
+				ioctl (perf_fd[i], PERF_EVENT_IOC_RESET, 0);
+				ioctl (perf_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+		clock_gettime (CLOCK_MONOTONIC, &t0);
+		sink = old ? (void *) bench_scan_old () : (void *) bench_scan_hot (ntasks);
+		clock_gettime (CLOCK_MONOTONIC, &t1);
+		for (i = 0; i < 2; ++i) {
+			if (perf_fd[i] >= 0) {
+				ioctl (perf_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+				if (read (perf_fd[i], &count, sizeof (count)) == sizeof (count)) {
+					misses[i] += count;
+				}
+			}
+		}
+		ns += (t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec;
+	}
+
+	// the same pick-next loop back to back (a proxy for the misses when they cannot be counted)
+	clock_gettime (CLOCK_MONOTONIC, &t0);
+	for (r = 0; r < BENCH_WARM; ++r) {
+		sink = old ? (void *) bench_scan_old () : (void *) bench_scan_hot (ntasks);
+	}
+	clock_gettime (CLOCK_MONOTONIC, &t1);
+	warm_ns = (t1.tv_sec - t0.tv_sec) * 1000000000ULL + t1.tv_nsec - t0.tv_nsec;
+	(void) sink;
+
+	printf ("%-4s %8.1f us/cold scan  %6.2f ns/task warm", name, ns / 1000.0 / rounds,
+		(double) warm_ns / BENCH_WARM / ntasks);
+	if (perf_fd[0] < 0 && perf_fd[1] < 0) {
+		printf ("  counters unavailable");
+	}
+	for (i = 0; i < 2; ++i) {
+		if (perf_fd[i] >= 0) {
+			printf ("  %9.1f %s", (double) misses[i] / rounds, i == 0 ? "cache-misses" : "L1d-misses");
+		}
+	}
+	printf ("  (sizeof: %zu bytes of state per task)\n", old
+		? sizeof (struct bench_oldproc) + sizeof (struct sched_procnode)
+		: sizeof (struct sched_hot));
+}
+
+// sleep for a tick rounds times and record how long each wakeup took to get the cpu
+void bench_wake_measure (int i) {
+	unsigned long long delay, last, pcount;
+	int r;
+
+	wake_avg[i] = wake_max[i] = 0;
+	for (r = 0; r < wake_rounds; ++r) {
+		sched_getdelay (sched_getpid (), &last, &pcount);
+		sched_pause_ticks (1);
+		sched_getdelay (sched_getpid (), &delay, &pcount);
+		delay -= last;
+		wake_avg[i] += delay;
+		if (delay > wake_max[i]) {
+			wake_max[i] = delay;
+		}
+	}
+	wake_avg[i] /= wake_rounds;
+}
+
+// init of the wakeup benchmark: fork the spinner, then measure with and without wakeup preemption
+void bench_wake_init () {
+	int rc;
+
+	if (sched_fork () == 0) {
+		sched_nice (BENCH_WAKE_NICE);
+		while (!wake_done);
+		sched_exit (0);
+	}
+
+	sched_setwakeup (SCHED_WAKEUP_MARGIN);
+	bench_wake_measure (0);
+	sched_setwakeup (-1);
+	bench_wake_measure (1);
+
+	wake_done = 1;
+	sched_wait (&rc);
+	sched_exit (0);
+}
+
+int bench_wake (int rounds) {
+	struct itimerval off;
+	int out_fd, null_fd;
+
+	// the scheduler prints a listing at every switch; keep it out of the results
+	fflush (stdout);
+	if ((out_fd = dup (1)) < 0 || (null_fd = open ("/dev/null", O_WRONLY)) < 0 || dup2 (null_fd, 1) < 0) {
+		fprintf (stderr, "ERROR: Output of the scheduler could not be redirected!\n");
+		fprintf (stderr, "--> dup() or open() failure: %s\n", strerror (errno));
+		return 1;
+	}
+	close (null_fd);
+
+	wake_rounds = rounds;
+	if (sched_init (bench_wake_init) < 0) {
+		return 1;
+	}
+
+	// stop the tick now that init has returned
+	memset (&off, 0, sizeof (off));
+	setitimer (ITIMER_VIRTUAL, &off, NULL);
+
+	fflush (stdout);
+	dup2 (out_fd, 1);
+	close (out_fd);
+
+	printf ("wakeup latency over %d sleeps of a tick (%llu ms), next to a spinning task of nice %d\n",
+		rounds, SCHED_TICK_NS / 1000000, BENCH_WAKE_NICE);
+	printf ("preemption on  %8.3f ms avg  %8.3f ms max\n", wake_avg[0] / 1e6, wake_max[0] / 1e6);
+	printf ("preemption off %8.3f ms avg  %8.3f ms max\n", wake_avg[1] / 1e6, wake_max[1] / 1e6);
+
+	return 0;
+}
+
+int main (int argc, char ** argv) {
+	unsigned int ntasks, i;
+	int rounds, opt, wake;
+
+	ntasks = SCHED_NPROC;
+	rounds = 0;
+	wake = 0;
+	while ((opt = getopt (argc, argv, "n:r:w")) != -1) {
+		switch (opt) {
+			case 'n':
+				ntasks = atoi (optarg);
+				break;
+			case 'r':
+				rounds = atoi (optarg);
+				break;
+			case 'w':
+				wake = 1;
+				break;
+			default:
+				fprintf (stderr, "usage: %s [-n tasks] [-r rounds]\n       %s -w [-r rounds]\n", argv[0], argv[0]);
+				return 1;
+		}
+	}
+	if (rounds == 0) {
+		rounds = wake ? 10 : 50;
+	}
+	if (wake) {
+		if (rounds < 0) {
+			fprintf (stderr, "ERROR: Bad arguments!\n");
+			fprintf (stderr, "--> rounds >= 1\n");
+			return 1;
+		}
+		return bench_wake (rounds);
+	}
+	if (ntasks == 0 || ntasks > SCHED_NPROC || rounds <= 0) {
+		fprintf (stderr, "ERROR: Bad arguments!\n");
+		fprintf (stderr, "--> 1 <= tasks <= %d, rounds >= 1\n", SCHED_NPROC);
+		return 1;
+	}
+
+	if ((evict = (volatile unsigned char *) malloc (BENCH_EVICT)) == NULL) {
+		fprintf (stderr, "ERROR: Eviction buffer could not be allocated!\n");
+		fprintf (stderr, "--> malloc() failure: %s\n", strerror (errno));
+		return 1;
+	}
+	memset ((void *) evict, 0, BENCH_EVICT);
+
+	// build both layouts with the same task states (a quarter of the tasks sleep)
+	old_anchor.prev = old_anchor.next = &old_anchor;
+	old_anchor.proc = NULL;
+	for (i = 1; i <= ntasks; ++i) {
+		struct bench_oldproc * p;
+		struct sched_procnode * pn;
+		if ((p = (struct bench_oldproc *) calloc (1, sizeof (*p))) == NULL
+			|| (pn = (struct sched_procnode *) malloc (sizeof (*pn))) == NULL) {
+			fprintf (stderr, "ERROR: Tasks could not be allocated!\n");
+			fprintf (stderr, "--> malloc() failure: %s\n", strerror (errno));
+			return 1;
+		}
+		p->pid = i;
+		p->nice = (signed short int) (i % 40) - 20;
+		p->task_state = i % 4 == 0 ? SCHED_SLEEPING : SCHED_READY;
+		p->my_procnode = pn;
+		pn->proc = (struct sched_proc *) p;
+		pn->prev = old_anchor.prev;
+		pn->next = &old_anchor;
+		old_anchor.prev->next = pn;
+		old_anchor.prev = pn;
+
+		hot[i].nice = p->nice;
+		hot[i].task_state = p->task_state;
+	}
+	for (i = ntasks + 1; i <= SCHED_NPROC; ++i) {
+		hot[i].task_state = SCHED_UNUSED;
+	}
+
+	perf_fd[0] = bench_perf_open (PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	perf_fd[1] = bench_perf_open (PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+		| (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+	if (perf_fd[0] < 0 && perf_fd[1] < 0) {
+		printf ("counters unavailable: perf_event_open() failure: %s (cache misses are not measured, see the warm timing)\n",
+			strerror (errno));
+	}
+
+	printf ("%u tasks, %d cold scans and %d warm scans each\n", ntasks, rounds, BENCH_WARM);
+	bench_run ("old", 1, ntasks, rounds);
+	bench_run ("hot", 0, ntasks, rounds);
+
+	return 0;
+}
@@ -0,0 +1,123 @@
+#include <stdatomic.h>
+#include "usched.h"
+
+// schedtop [-n count] [-i interval_ms] [name | pid]
+//   Print the stats table published by a running scheduler (see
+//   sched_stats_open) every interval_ms milliseconds (1000 by default),
+//   count times (forever by default).  The table is given by its
+//   shared-memory name, or by the pid of the program running the
+//   scheduler (SCHED_STATS_NAME); it is only ever read, so watching it
+//   has no effect on the scheduled tasks.
+
+static struct sched_stats snap;          // consistent copy of the table
+static unsigned long long last_runtime[SCHED_NPROC + 1];
+static unsigned long long last_ticks;
+
+// copy the table, retrying while the scheduler is writing to it
+void schedtop_snapshot (const struct sched_stats * st) {
+	unsigned int seq, pid_max;
+
+	for (;;) {
+		seq = st->seq;
+		atomic_thread_fence (memory_order_acquire);
+		if (seq & 1) continue;
+
+		pid_max = st->pid_max;
+		if (pid_max > SCHED_NPROC) pid_max = SCHED_NPROC;
+		memcpy (&snap, (const void *) st, (const char *) &st->rows[pid_max + 1] - (const char *) st);
+		snap.pid_max = pid_max;
+
+		atomic_thread_fence (memory_order_acquire);
+		if (st->seq == seq) break;
+	}
+}
+
+void schedtop_print () {
+	static const char * states[] = { "READY", "RUNNING", "SLEEPING", "ZOMBIE" };
+	struct sched_stats_row * row;
+	unsigned long long dticks;
+	unsigned int pid, ntasks;
+
+	ntasks = 0;
+	for (pid = 1; pid <= snap.pid_max; ++pid) {
+		if (snap.rows[pid].task_state <= SCHED_ZOMBIE) ntasks += 1;
+	}
+
+	dticks = snap.ticks - last_ticks;
+	printf ("ticks %llu  switches %llu  tasks %u  running %u\n",
+		snap.ticks, snap.switches, ntasks, snap.current_pid);
+	printf ("PID\tPPID\tSTATE\t\tNICE\tDYN\tGROUP\tCPU_TIME\t%%CPU\tSTACK_BASE\tSTACK_USED\n");
+	for (pid = 1; pid <= snap.pid_max; ++pid) {
+		row = &snap.rows[pid];
+		if (row->task_state > SCHED_ZOMBIE) continue;
+
+		printf ("%04u\t%04u\t%-8s\t%d\t%u\t%u\t%llu\t\t%llu\t%#llx\t%llu\n",
+			row->pid, row->ppid, states[row->task_state], row->nice, row->priority, row->group,
+			row->runtime / SCHED_TICK_NS,
+			dticks == 0 || row->runtime < last_runtime[pid] ? 0 : (row->runtime - last_runtime[pid]) * 100 / (dticks * SCHED_TICK_NS),
+			row->stack_base, row->stack_used);
+		last_runtime[pid] = row->runtime;
+	}
+	printf ("\n");
+	fflush (stdout);
+
+	last_ticks = snap.ticks;
+}
+
+int main (int argc, char ** argv) {
+	int opt, fd;
+	long count, interval;
+	char name[64];
+	const struct sched_stats * st;
+
+	count = -1;
+	interval = 1000;
+	while ((opt = getopt (argc, argv, "n:i:")) != -1) {
+		switch (opt) {
+			case 'n':
+				count = atol (optarg);
+				break;
+			case 'i':
+				interval = atol (optarg);
+				break;
+			default:
+				fprintf (stderr, "usage: %s [-n count] [-i interval_ms] [name | pid]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (optind >= argc) {
+		fprintf (stderr, "usage: %s [-n count] [-i interval_ms] [name | pid]\n", argv[0]);
+		return 1;
+	}
+
+	// a pid stands for the default name of that program's table
+	if (argv[optind][0] >= '0' && argv[optind][0] <= '9') {
+		snprintf (name, sizeof (name), SCHED_STATS_NAME, atoi (argv[optind]));
+	} else {
+		snprintf (name, sizeof (name), "%s", argv[optind]);
+	}
+
+	if ((fd = shm_open (name, O_RDONLY, 0)) < 0
+		|| (st = mmap (0, sizeof (struct sched_stats), PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		fprintf (stderr, "ERROR: Stats table %s could not be opened!\n", name);
+		fprintf (stderr, "--> shm_open() or mmap() failure: %s\n", strerror (errno));
+		return 1;
+	}
+	close (fd);
+
+	if (memcmp (st->magic, SCHED_STATS_MAGIC, sizeof (SCHED_STATS_MAGIC)) != 0 || st->version != SCHED_STATS_VERSION) {
+		fprintf (stderr, "ERROR: Stats table %s could not be opened!\n", name);
+		fprintf (stderr, "--> not a version %d stats table\n", SCHED_STATS_VERSION);
+		return 1;
+	}
+
+	for (; count != 0; count = count > 0 ? count - 1 : count) {
+		schedtop_snapshot (st);
+		schedtop_print ();
+		if (count != 1) {
+			usleep (interval * 1000);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,181 @@
+#include <dirent.h>
+#include <stdatomic.h>
+#include "usched.h"
+
+struct sched_stats * sched_stats;
+static char stats_name[64];
+
+// the writer side of the seqlock (there is only one writer, so no atomic update is needed)
+static void sched_stats_begin () {
+	sched_stats->seq += 1;                    // odd: readers retry
+	atomic_thread_fence (memory_order_release);
+}
+
+static void sched_stats_end () {
+	atomic_thread_fence (memory_order_release);
+	sched_stats->seq += 1;                    // even again
+}
+
+// copy the scheduling columns of a row from the hot array
+static void sched_stats_hot (unsigned int pid) {
+	struct sched_stats_row * row;
+
+	row = &sched_stats->rows[pid];
+	row->task_state = sched_hot[pid].task_state;
+	row->nice = sched_hot[pid].nice;
+	row->priority = sched_hot[pid].priority;
+	row->group = sched_hot[pid].group;
+	row->runtime = sched_hot[pid].runtime;
+}
+
+// remove the tables left behind by programs that did not exit normally (the
+//   segments only go away at exit, or on reboot); they are named after their
+//   pid, so any whose pid no longer exists can go (shm segments live in /dev/shm)
+static void sched_stats_sweep () {
+	DIR * dir;
+	struct dirent * d;
+	char stale[64];
+	int pid;
+
+	if ((dir = opendir ("/dev/shm")) == NULL) return;
+	while ((d = readdir (dir)) != NULL) {
+		if (sscanf (d->d_name, SCHED_STATS_NAME + 1, &pid) != 1 || pid <= 0) continue;
+		snprintf (stale, sizeof (stale), SCHED_STATS_NAME, pid);
+		if (strcmp (stale + 1, d->d_name) != 0) continue;   // (only exactly our names)
+		if (kill (pid, 0) < 0 && errno == ESRCH) {
+			shm_unlink (stale);
+		}
+	}
+	closedir (dir);
+}
+
+int sched_stats_open (const char * name) {
+	int fd;
+	struct sched_procnode * pn;
+	struct sched_zombie * z;
+	unsigned int pid;
+
+	if (sched_stats != NULL) {
+		sched_stats_close ();
+	}
+
+	if (name == NULL) {
+		sched_stats_sweep ();
+		snprintf (stats_name, sizeof (stats_name), SCHED_STATS_NAME, (int) getpid ());
+	} else {
+		snprintf (stats_name, sizeof (stats_name), "%s", name);
+	}
+
+	// create the segment and map it
+	if ((fd = shm_open (stats_name, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+		fprintf (stderr, "ERROR: Stats table %s could not be created!\n", stats_name);
+		fprintf (stderr, "--> shm_open() failure: %s\n", strerror (errno));
+		return -1;
+	}
+	if (ftruncate (fd, sizeof (struct sched_stats)) < 0
+		|| (sched_stats = mmap (0, sizeof (struct sched_stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		fprintf (stderr, "ERROR: Stats table %s could not be created!\n", stats_name);
+		fprintf (stderr, "--> ftruncate() or mmap() failure: %s\n", strerror (errno));
+		sched_stats = NULL;
+		close (fd);
+		shm_unlink (stats_name);
+		return -1;
+	}
+	close (fd);
+
+	// fill in the header and every row there is (from then on, a row is
+	//   only written when something about its process changes)
+	sched_stats_begin ();
+	memcpy (sched_stats->magic, SCHED_STATS_MAGIC, sizeof (SCHED_STATS_MAGIC));
+	sched_stats->version = SCHED_STATS_VERSION;
+	for (pid = 1; pid <= sched_pid_max; ++pid) {
+		sched_stats_hot (pid);
+	}
+	sched_stats_end ();
+	for (pn = proc_anchor.next; pn->proc != NULL; pn = pn->next) {
+		sched_stats_ident (pn->proc->pid, sched_parent (&pn->proc->plink)->pid, pn->proc->stack_base);
+		for (z = pn->proc->zombies; z != NULL; z = z->next) {
+			sched_stats_ident (z->pid, pn->proc->pid, NULL);
+		}
+	}
+	sched_stats_publish (current);
+
+	// (only the first call registers; later ones reuse it)
+	static int registered;
+	if (registered == 0) {
+		atexit (sched_stats_close);
+		registered = 1;
+	}
+
+	return 0;
+}
+
+void sched_stats_close () {
+	if (sched_stats == NULL) return;
+
+	munmap (sched_stats, sizeof (struct sched_stats));
+	sched_stats = NULL;
+	shm_unlink (stats_name);
+}
+
+void sched_stats_publish (struct sched_proc * prev) {
+	struct sched_stats_row * row;
+
+	if (sched_stats == NULL) return;
+
+	sched_stats_begin ();
+	sched_stats->pid_max = sched_pid_max;
+	sched_stats->current_pid = current->pid;
+	sched_stats->ticks = sched_ticks;
+	sched_stats->switches += 1;
+
+	// only prev and the process switched to have changed (the others are
+	//   brought up to date by sched_stats_update as they are woken or reaped)
+	sched_stats_hot (prev->pid);
+	sched_stats_hot (current->pid);
+
+	// the stack of prev has just been saved (a zombie has none left), and
+	//   its parent may have changed since it was created (if it was orphaned)
+	row = &sched_stats->rows[prev->pid];
+	if (prev->hot->task_state == SCHED_ZOMBIE || prev->stack_base == NULL) {
+		row->stack_used = 0;
+	} else {
+		row->stack_used = (unsigned long long) (prev->stack_base - prev->pctx.regs[JB_SP]);
+		row->ppid = sched_parent (&prev->plink)->pid;
+	}
+	sched_stats_end ();
+}
+
+void sched_stats_update (unsigned int pid) {
+	if (sched_stats == NULL) return;
+
+	sched_stats_begin ();
+	sched_stats->pid_max = sched_pid_max;
+	sched_stats_hot (pid);
+	sched_stats_end ();
+}
+
+void sched_stats_tick () {
+	if (sched_stats == NULL) return;
+
+	sched_stats_begin ();
+	sched_stats->ticks = sched_ticks;
+	sched_stats->rows[current->pid].runtime = current->hot->runtime;
+	sched_stats_end ();
+}
+
+void sched_stats_ident (unsigned int pid, unsigned int ppid, void * stack_base) {
+	struct sched_stats_row * row;
+
+	if (sched_stats == NULL) return;
+
+	sched_stats_begin ();
+	row = &sched_stats->rows[pid];
+	row->pid = pid;
+	row->ppid = ppid;
+	row->stack_base = (unsigned long long) stack_base;
+	if (stack_base == NULL) {
+		row->stack_used = 0;
+	}
+	sched_stats_end ();
+}
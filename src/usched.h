@@ -0,0 +1,866 @@
+#ifndef __USCHED_H__
+#define __USCHED_H__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "savectx64.h"
+
+#define SCHED_NPROC    4096              // 1 <= pid <= SCHED_NPROC
+#define SCHED_READY       0
+#define SCHED_RUNNING     1
+#define SCHED_SLEEPING    2
+#define SCHED_ZOMBIE      3
+#define SCHED_SWITCH_RET  4
+#define SCHED_EXIT_RET    5
+#define SCHED_INIT_RET    6
+#define SCHED_UNUSED      7              // task_state of a sched_hot slot whose pid is not in use
+#define SCHED_RESTORE_RET 8
+
+#define SCHED_TICK_NS  100000000ULL      // length of a tick (interval of the itimer) in ns
+#define SCHED_TSC_CALIBRATE 5000000      // ns over which the TSC frequency is measured
+
+#define STACK_SIZE    65536              // in bytes (length of mapping for stack)
+#define SCHED_FORK_SLACK  4096          // bytes below sched_fork's frame that are copied to the child as well
+#define SCHED_SPAWN_COPY_MAX 1024        // largest argument sched_spawn_copy places on the new stack (in bytes)
+
+#define SCHED_WNOHANG     1              // sched_waitpid flag: return 0 instead of sleeping
+
+#define SCHED_CKPT_MAGIC   "SCHEDCK"     // first bytes of a checkpoint file
+#define SCHED_CKPT_VERSION    8
+#define SCHED_CKPT_REDZONE  128          // bytes below the saved stack pointer that are also saved
+#define SCHED_CKPT_BATCH     64          // process records read at a time by sched_restore
+
+#define SCHED_TRIM_TICKS     10          // default ticks asleep after which a stack is trimmed
+
+#define SCHED_SLEEP_AVG_MAX  10          // ticks of sleep credit a process can bank (for the interactivity bonus)
+#define SCHED_MAX_BONUS      10          // dynamic priority ranges from -SCHED_MAX_BONUS/2 to +SCHED_MAX_BONUS/2 around the static one
+#define SCHED_WAKEUP_MARGIN   5          // default dynamic priority lead a woken process needs to preempt the running one
+
+#define SCHED_MSG_SPAWN       0          // inbox message: start a new process running fn (arg)
+#define SCHED_MSG_WAKE        1          // inbox message: wake up process pid
+#define SCHED_MSG_DATA        2          // inbox message: deliver a message to the mailbox of process pid
+
+#define SCHED_STATS_MAGIC  "SCHEDST"     // first bytes of the shared-memory stats table
+#define SCHED_STATS_VERSION   2
+#define SCHED_STATS_NAME   "/sched.%d"   // default name of the stats table (with the pid of the program)
+
+#define SCHED_NGROUP        64           // 0 <= gid < SCHED_NGROUP (gid 0 is the root group)
+#define SCHED_SHARES_DEFAULT 1024        // cpu shares of a new group (and weight of a group's own tasks)
+#define SCHED_SHARES_MIN       2
+#define SCHED_SHARES_MAX  262144
+
+extern struct savectx global_ctx;        // the global context of the container of init
+
+extern int adjstack ();                  // fix the saved %rbp regs in a given stack
+
+struct sched_msg;                        // inbox / mailbox message (private to inbox.c)
+
+// node of doubly-linked list expressing a set of processes
+struct sched_procnode {
+	struct sched_procnode * prev;        // previous sched_procnode
+	struct sched_procnode * next;        // next sched_procnode
+	struct sched_proc * proc;            // pointer to associated process struct sched_proc
+};
+
+// link from the children (living and zombie) of a process to it; when the
+//   process exits, its link is forwarded to that of the process adopting the
+//   children, which reparents all of them with one pointer swap, and each
+//   child follows (and shortens) the chain the next time its parent is
+//   looked up (see sched_parent)
+struct sched_plink {
+	struct sched_proc * parent;          // the process, or NULL once it has exited
+	struct sched_plink * fwd;            // link of the adopting process (once parent is NULL)
+	unsigned int refs;                   // children, zombies and links pointing here, plus 1 for the process
+};
+
+// scheduling-hot process information (read or written on every tick and switch)
+//   these live in the pid-indexed sched_hot array so that a scan over all tasks
+//   streams through two tasks per cache line instead of a whole sched_proc each
+struct sched_hot {
+	unsigned long long runtime;          // time the process has been on the cpu in total (in ns)
+	unsigned int slice_acc;              // how long the process has been on the cpu since last scheduled (in ns, saturating)
+	unsigned short int slice_max;        // how long the process has to do its thing (in ticks)
+	unsigned short int sleep_avg;        // sleep credit: ticks slept minus ticks run, 0 to SCHED_SLEEP_AVG_MAX
+	unsigned short int task_state;       // UNUSED, READY, RUNNING, SLEEPING, ZOMBIE
+	unsigned short int priority;         // 0 to 39, static priority plus the sleep_avg bonus (used by scheduler)
+	signed short int nice;               // -20 to 19 (used by scheduler)
+	unsigned short int group;            // gid of the task group this process is attached to
+	struct sched_proc * proc;            // pointer to the cold sched_proc of this process
+} __attribute__ ((aligned (32)));
+
+// resource usage of a process, kept once it has exited
+struct sched_rusage {
+	unsigned long long cpu_time;         // time the process was on the cpu in total (in ticks)
+	unsigned long long runtime;          // the same in ns
+	unsigned long long stack_rss;        // bytes of its stack that were resident when it exited
+};
+
+// compact record a process is shrunk to by sched_exit (its stack, sched_proc
+//   and procnodes are released right away); it sits on the parent's zombie
+//   list until sched_wait reaps it, and the hot slot of the pid stays ZOMBIE
+struct sched_zombie {
+	unsigned int pid;                    // process ID
+	struct sched_plink * plink;          // link to the parent
+	int exit_code;                       // the exit code of the process
+	struct sched_rusage ru;              // resources used by the process
+	struct sched_zombie * next;          // next zombie of the same parent
+};
+
+// process information structure (cold state: identity, register context, tree linkage)
+struct sched_proc {
+	struct sched_hot * hot;              // pointer to this process' slot in sched_hot
+	unsigned int pid;                    // process ID
+	int exit_code;                       // the exit code of the process
+	void * stack_base;                   // pointer to the BASE of the stack (TOP of stack is in LOWER memory)
+	struct savectx pctx;                 // contains context regs, including base ptr, stack ptr, and prog counter
+	struct sched_plink * plink;          // link to the parent (init links to itself)
+	struct sched_plink * child_link;     // the link of this process (its children's plink)
+	unsigned short int subreaper;        // 1 if orphaned descendants are handed to this process
+	struct sched_procnode * my_procnode; // pointer to the procnode for this sched_proc
+	struct sched_procnode * sib_procnode;// pointer to the procnode in the parent's child list
+	struct sched_procnode child_anchor;  // doubly-linked list of children's sched_proc
+	struct sched_zombie * zombies;       // singly-linked list of exited, unreaped children
+	struct sched_zombie * zombies_tail;  // last entry of zombies (for splicing the list)
+	struct sched_zombie * zrec;          // preallocated record this process shrinks to on exit
+	struct sched_procnode sleep_node;    // node in sleep_anchor while asleep and untrimmed
+	unsigned long long sleep_start;      // sched_ticks value at which the process went to sleep
+	unsigned long long ready_since;      // sched_clock () value at which the process last became READY
+	unsigned long long run_delay;        // time spent READY waiting for the cpu in total (in ns)
+	unsigned long long pcount;           // number of times the process has been switched to
+	struct sched_msg * mbox;             // messages delivered to the process, oldest first
+	struct sched_msg * mbox_tail;        // last entry of mbox
+	unsigned short int wake_pending;     // a wakeup (see sched_pause) arrived while the process was not asleep
+	void (* spawn_fn) (void *);          // function a spawned process runs (NULL for forked ones)
+	void * spawn_arg;                    // its argument
+	struct sched_procnode timer_node;    // node in timer_anchor while in sched_pause_ticks
+	unsigned long long wake_tick;        // sched_ticks value at which sched_pause_ticks times out
+};
+
+// memory accounting of the scheduler (see sched_memstat)
+struct sched_memstat {
+	unsigned long long stack_mapped;     // bytes of stack mapped by living processes (and the one not yet released)
+	unsigned long long stack_resident;   // bytes of those that are resident
+	unsigned long long stack_released;   // bytes of stack unmapped at exit so far
+	unsigned long long stack_trimmed;    // resident bytes released from long sleepers so far
+	unsigned long long zombies;          // number of zombies waiting to be reaped
+	unsigned long long zombie_bytes;     // bytes held by those zombies
+};
+
+// task group (cgroup-like); groups form a tree rooted at gid 0, and every
+//   process is attached to exactly one group (inherited across sched_fork)
+//   sched_switch first picks a group by walking down the tree, at each level
+//   choosing the child (or the group's own tasks) with the least weighted
+//   vruntime; groups with a quota are throttled once they have used it up
+//   for the current period, and are refreshed lazily when next looked at
+//   every group with a READY or RUNNING process in its subtree is queued
+//   on the list of its parent (kept up to date as processes are woken up,
+//   created, go to sleep, exit or change groups), so that the walk only
+//   looks at groups that have something to run
+struct sched_group {
+	unsigned short int in_use;           // 1 if this gid is allocated
+	unsigned short int parent;           // gid of the parent group (the root is its own parent)
+	unsigned int shares;                 // weight relative to the sibling groups
+	unsigned int nr_tasks;               // number of living processes attached directly
+	unsigned int nr_children;            // number of child groups
+	unsigned long long vruntime;         // cpu time (ns) of the whole subtree, scaled by SCHED_SHARES_DEFAULT / shares
+	unsigned long long self_vruntime;    // cpu time (ns) of the directly attached processes (default weight)
+	unsigned long long quota;            // ticks the subtree may run per period (0 means unlimited)
+	unsigned long long period;           // length of a bandwidth period (in ticks)
+	unsigned long long period_start;     // sched_ticks value at which the current period began
+	unsigned long long runtime;          // ns used by the subtree in the current period
+	unsigned short int throttled;        // 1 if the quota is used up for the current period
+	unsigned int nr_queued;              // number of directly attached processes that are READY or RUNNING
+	struct sched_group * queued_head;    // first queued child group (NULL if none)
+	struct sched_group * queued_prev;    // neighbours on the list of queued children of the parent
+	struct sched_group * queued_next;
+	unsigned short int blocked;          // sched_group_pick scratch: nothing in the subtree may run
+	unsigned short int unrun;            // sched_switch scratch: a READY process has not run this cycle
+	struct sched_hot * best;             // sched_switch scratch: best directly attached READY process
+};
+
+// header of a checkpoint file (followed by one sched_ckpt_proc per process,
+//   living ones in proc_anchor order and then the zombies, and then the saved stack pages at page-aligned offsets)
+//   the addresses are only used to check that the restoring program has the
+//   same layout as the one that wrote the file (saved registers point into it)
+struct sched_ckpt_header {
+	char magic[8];                       // SCHED_CKPT_MAGIC
+	unsigned int version;                // SCHED_CKPT_VERSION
+	unsigned int nproc;                  // number of sched_ckpt_proc records
+	unsigned int current_pid;            // the process that called sched_checkpoint
+	unsigned int pid_max;                // sched_pid_max
+	unsigned long long ticks;            // sched_ticks
+	unsigned long long trim_ticks;       // sched_trim_ticks
+	int wakeup_margin;                   // sched_wakeup_margin
+	void * text_addr;                    // address of sched_switch
+	void * data_addr;                    // address of sched_hot
+	void * libc_addr;                    // address of the stdout FILE
+	struct sched_memstat mem;            // sched_mem (running totals)
+	struct sched_group groups[SCHED_NGROUP];
+};
+
+// per-process record of a checkpoint file
+struct sched_ckpt_proc {
+	struct sched_hot hot;                // hot state (hot.proc is meaningless)
+	unsigned int pid;                    // process ID
+	unsigned int ppid;                   // parent process ID
+	int exit_code;                       // the exit code of the process
+	void * stack_base;                   // original BASE of the stack
+	struct savectx pctx;                 // saved context regs
+	unsigned long long stack_off;        // file offset of the saved part of the stack
+	unsigned long long stack_len;        // length of the saved part (it ends at stack_base)
+	struct sched_rusage ru;              // resources used (zombies only)
+	unsigned long long run_delay;        // run delay accounting (living processes only)
+	unsigned long long pcount;
+	void (* spawn_fn) (void *);          // spawn_fn and spawn_arg (living processes only)
+	void * spawn_arg;
+	unsigned short int wake_pending;
+	unsigned long long wake_tick;        // timeout of a sched_pause_ticks () in progress (0 if none)
+	unsigned short int subreaper;
+};
+
+// one row of the shared-memory stats table (the row index is the pid)
+struct sched_stats_row {
+	unsigned int pid;                    // process ID
+	unsigned int ppid;                   // parent process ID
+	unsigned short int task_state;       // as in sched_hot (SCHED_UNUSED for a free pid)
+	signed short int nice;               // -20 to 19
+	unsigned short int priority;         // dynamic priority
+	unsigned short int group;            // gid of the task group
+	unsigned long long runtime;          // time the process has been on the cpu in total (in ns)
+	unsigned long long stack_base;       // BASE of the stack (0 for zombies)
+	unsigned long long stack_used;       // bytes between the stack base and the saved stack pointer
+};
+
+// stats table published by the scheduler in a named shared-memory segment
+//   (see sched_stats_open); there is a single writer, the scheduler, which
+//   makes seq odd while it updates the table, so a reader takes a consistent
+//   copy by retrying until seq is even and unchanged across the copy
+struct sched_stats {
+	char magic[8];                       // SCHED_STATS_MAGIC
+	unsigned int version;                // SCHED_STATS_VERSION
+	volatile unsigned int seq;           // seqlock sequence number
+	unsigned int pid_max;                // rows 1 to pid_max are in use
+	unsigned int current_pid;            // the process on the cpu
+	unsigned long long ticks;            // sched_ticks
+	unsigned long long switches;         // number of context switches
+	struct sched_stats_row rows[SCHED_NPROC + 1];
+};
+
+// current holds a pointer to the current process
+extern struct sched_proc * current;
+
+// doubly-linked list of all living processes (including zombies)
+extern struct sched_procnode proc_anchor;
+
+// hot scheduling state of every process, indexed by pid (64-byte aligned)
+extern struct sched_hot sched_hot[SCHED_NPROC + 1];
+
+// highest pid handed out so far (bounds scans over sched_hot)
+extern unsigned int sched_pid_max;
+
+// sleeping processes whose stacks have not been trimmed yet, oldest first
+extern struct sched_procnode sleep_anchor;
+
+// processes sleeping in sched_pause_ticks (), ordered by wake_tick
+extern struct sched_procnode timer_anchor;
+
+// number of living processes that are subreapers
+extern unsigned int sched_subreapers;
+
+// ticks a process must sleep before the unused part of its stack is released
+extern unsigned long long sched_trim_ticks;
+
+// process that has exited last; released by sched_release_dead
+extern struct sched_proc * sched_dead;
+
+// running totals for sched_memstat
+extern struct sched_memstat sched_mem;
+
+// all task groups, indexed by gid
+extern struct sched_group sched_groups[SCHED_NGROUP];
+
+// number of timer ticks since startup (drives the group bandwidth periods)
+extern unsigned long long sched_ticks;
+
+// sched_clock () value at which the current process was switched to (or last charged)
+extern volatile unsigned long long sched_run_start;
+
+// dynamic priority lead a woken process needs to preempt the running one (< 0 disables)
+extern int sched_wakeup_margin;
+
+// woken process that is to preempt the current one at the next safe point (need_resched)
+extern struct sched_proc * sched_wakee;
+
+// the stats table (NULL if it is not published)
+extern struct sched_stats * sched_stats;
+
+// holds information about which pids are available for claiming
+//   (a pid stays claimed while its process is a zombie, until it is reaped)
+extern unsigned short int pid_table[SCHED_NPROC + 1];
+
+// these work like setjmp and longjmp ((re)storing the context (registers))
+int savectx (struct savectx * ctx);
+void restorectx (struct savectx * ctx, int retval);
+
+// sched_init (void (* init_fn) ());
+//   This function will be called once by the testbed program.
+//   It should initialize your scheduling system, including
+//   setting up a periodic interval timer (see setitimer),
+//   establishing sched_tick as the signal handler for
+//   that timer, and creating the initial task which will
+//   have pid of 1.  After doing so, make pid 1 runnable and
+//   transfer execution to it (including switching to its
+//   stack) at location init_fn.  This init_fn function is not
+//   expected to return and if it does so it is OK to
+//   have unpredictable results.
+signed short int sched_init (void (* init_fn) ());
+
+// sched_settimer ();
+//   Establish sched_tick () as the handler for SIGVTALRM and
+//   sched_ps_abort () as the handler for SIGABRT, and start the periodic
+//   interval timer that drives the ticks.  Used by sched_init ()
+//   and sched_restore ().  Returns 0, or -1 on error.
+int sched_settimer ();
+
+// sched_fork ();
+//   Just like the real fork, create a new simulated task which
+//   is a copy of the caller.  Allocate a new pid for the
+//   child, and make the child runnable and eligible to
+//   be scheduled.  sched_fork returns 0 to the child and
+//   the child's pid to the parent.  It is not required that
+//   the relative order of parent vs child being scheduled
+//   be defined.  On error, return -1.
+int sched_fork ();
+
+// sched_exit (int code);
+//   Terminate the current task, making it a ZOMBIE, and store
+//   the exit code.  The task shrinks to a sched_zombie record;
+//   its stack and sched_proc are released later by another
+//   task (see sched_release_dead ()).  If a parent is sleeping in sched_wait (),
+//   wake it up (see sched_wakeup ()) and return the exit code to it.
+//   Children and unreaped zombies are handed to the nearest subreaper
+//   among the ancestors (see sched_set_subreaper ()), or else to the
+//   parent, in constant time whatever their number.
+//   There will be no equivalent of SIGCHLD.  sched_exit
+//   will not return.  Another runnable process will be scheduled.
+void sched_exit (int code);
+
+// sched_set_subreaper (int on);
+//   Make the current task a subreaper (or no longer one, if on is 0):
+//   the children of descendants that exit are then handed to it rather
+//   than to their grandparent, and it is woken up to reap any zombies
+//   it adopts.  Children do not inherit this.
+void sched_set_subreaper (int on);
+
+// sched_parent (struct sched_plink ** link);
+//   Return the process *link leads to, following forwarded links and
+//   pointing *link (and every link passed on the way) straight at the
+//   final one.  Must be called with signals blocked.
+struct sched_proc * sched_parent (struct sched_plink ** link);
+
+// sched_plink_new (struct sched_proc * proc);
+//   Allocate the link of proc (holding its own reference).  Returns
+//   the link, or NULL on error.
+struct sched_plink * sched_plink_new (struct sched_proc * proc);
+
+// sched_plink_put (struct sched_plink * link);
+//   Drop a reference to link, freeing it (and dropping its reference
+//   on the link it forwards to) once there are none left.
+void sched_plink_put (struct sched_plink * link);
+
+// sched_wait (int * exit_code);
+//   Return the exit code of a zombie child and free the
+//   (compact) zombie record of that child.  If there is more
+//   than one such child, the order in which the codes are
+//   returned is not defined.  If there are no zombie children,
+//   but the caller does have at least one child, place
+//   the caller in SLEEPING, to be woekn up when a child
+//   calls sched_exit ().  If there are no children, return
+//   immediately with -1, otherwise the return value is the
+//   pid of the child whose status is being returned.
+//   Since there are no simulated signals, the exit code
+//   is simply the integer from sched_exit ().
+int sched_wait (int * exit_code);
+
+// sched_waitpid (unsigned int pid, int * exit_code, int flags);
+//   Like sched_wait (), but for the child pid only: sleep until it
+//   has exited (or return 0 right away if flags has SCHED_WNOHANG),
+//   then reap it.  Returns pid, or -1 if pid is not a child (living
+//   or zombie) of the caller.
+int sched_waitpid (unsigned int pid, int * exit_code, int flags);
+
+// sched_reap (struct sched_zombie * z, int * exit_code);
+//   Release the pid and the record of zombie z (already taken off its
+//   parent's zombie list), storing its exit code in *exit_code.
+//   Returns the pid.  Used by sched_wait () and sched_waitpid ().
+int sched_reap (struct sched_zombie * z, int * exit_code);
+
+// sched_nice (int niceval);
+//   Set the current taks's "nice value" to the supplied parameter.
+//   Nice values may range from +19 (least preferred static
+//   priority) to -20 (most preferred).  Clamp any out-of-range
+//   values to those limits.
+void sched_nice (signed short int niceval);
+
+// sched_getpid ();
+//   Return current task's pid.
+unsigned int sched_getpid ();
+
+// sched_getppid ();
+//   Return pid of the parent of current task.
+unsigned int sched_getppid ();
+
+// sched_gettick ();
+//   Return the cpu time of the current task in ticks (its runtime in ns,
+//   up to this very moment, divided by SCHED_TICK_NS).
+unsigned long long sched_gettick ();
+
+// sched_ps ();
+//   Output to stdout a listing of all of the current tasks,
+//   including sleeping and zombie tasks.  List the
+//   following information in tabular form:
+//       pid
+//       ppid
+//       current state
+//       base addr of private stack area
+//       static priority
+//       dynamic priority info (see below)
+//       total CPU time used (in ticks)
+//       resident stack size (only from sched_ps_abort (), since it
+//         takes a system call per task; sched_switch calls sched_ps
+//         at every switch)
+//       average wait for the cpu
+//   ** "dynamic priority" will vary in interpretation and range
+//   depending on what scheduling algorithm you use.  E.g.
+//   if you follow the CFS outline, then vruntime will be the
+//   best indicator of dynamic priority.
+//
+//   You should establish sched_ps_abort () as the signal handler
+//   for SIGABRT so that a ps can be forced at any
+//   time by sending the testbed SIGABRT.  (schedtop shows the
+//   same kind of listing from the stats table, without stopping
+//   the scheduler; see sched_stats_open ().)
+void sched_ps ();
+
+// sched_ps_abort ();
+//   The SIGABRT handler: sched_ps () with the RSS column filled in.
+void sched_ps_abort ();
+
+// sched_switch ();
+//   This is the suggested name of a required routine which will
+//   never be called directly by the testbed.  sched_switch ()
+//   should be the sole place where a context switch is made,
+//   analogous to schedule () within the Linux kernel.
+//   sched_switch () should place the current task on the run queue
+//   (assuming it is READY), then select the best READY task from
+//   the runqueue, taking into account the dynamic priority
+//   of each task.  The selected task should then be placed
+//   in the RUNNING state and a context switch made to it
+//   (unless, of course, the best task is also the current task).
+//   See discussion below on support routines for context switch.
+int sched_switch ();
+
+// sched_tick ();
+//   This is the suggested name of a required routine which will
+//   never be called directly by the testbed, but instead will
+//   be the signal handler for the SIGVTALRM signal generated by
+//   the periodic timer.  Each occurrence of the timer signal
+//   is considered a tick.  The number of ticks since sched_init
+//   is to be returned by sched_gettick ().
+//   sched_tick should examine the currently running
+//   task and if its time slice has just expired, mark that
+//   task as READY, place it on the run queue based on its
+//   current dynamic priority, and then call sched_switch ()
+//   to cause a new task to be run.  Watch out for
+//   mask issues...remember SIGVTALARM will, by default,
+//   be masked on entry to your signal handler.
+void sched_tick ();
+
+// sched_blocksigs (sigset_t * block_sigset, sigset_t * old_sigset);
+//   Attempts to block all signals given by block_sigset, and
+//   stores the old signal mask in old_sigset for later restoration.
+int sched_blocksigs (sigset_t * block_sigset, sigset_t * old_sigset);
+
+// sched_unblocksigs (sigset_t * block_sigset, sigset_t * old_sigset);
+//   Attempts to unblock all signals given by block_sigset, and
+//   restores the old signal mask given by old_sigset.
+int sched_unblocksigs (sigset_t * block_sigset, sigset_t * old_sigset);
+
+// sched_getunusedpid ();
+//   Returns an unused pid in the pid_table.
+//   Returns 0 if no pids remain.
+unsigned short int sched_getunusedpid ();
+
+// sched_checkpoint (const char * path);
+//   Write the state of the whole scheduler (every sched_proc, the
+//   run queue state, the pid table, the task groups and the used part
+//   of every task stack) to the file path.  Messages that are still in
+//   the inbox or in mailboxes are not saved.  The file is written under
+//   a temporary name and renamed over path, so path may be the file the
+//   program was restored from.  Returns 0 once the file has been
+//   written, or -1 on error (path is then left as it was).  When the checkpoint is later
+//   resumed by sched_restore (), sched_checkpoint returns 1 in the
+//   task that called it, and all other tasks continue where they were.
+int sched_checkpoint (const char * path);
+
+// sched_restore (const char * path);
+//   Used by the testbed instead of sched_init ().  Rebuild the
+//   scheduler from a file written by sched_checkpoint (), mapping
+//   every saved stack back at its original address straight from the
+//   file (pages are only read in when touched), and resume the task
+//   that wrote the checkpoint.  Like sched_init (), this only returns
+//   (with 0) once init exits, or with -1 on error; what had been
+//   restored by then (stacks included) is undone, so the program may
+//   go on, e.g. with sched_init ().
+//   The saved registers point into the program and the C library, so
+//   the restoring program must be the same binary loaded at the same
+//   addresses (e.g. with address space randomization disabled).
+signed short int sched_restore (const char * path);
+
+// sched_release_dead ();
+//   Release the stack, sched_proc and procnodes of the task that
+//   exited last (which could not do so itself, since it was still
+//   running on that stack), and free the spent inbox messages (see
+//   sched_inbox_reclaim ()).  Only called with signals blocked from
+//   the entry points tasks call themselves (sched_fork, sched_spawn,
+//   sched_spawn_copy, sched_exit, sched_wait, sched_waitpid) and
+//   where a task is switched back to outside the tick handler (which
+//   must not call free or munmap): on waking up in sched_sleep, and
+//   when a forked or spawned task first runs.  Since sched_exit calls
+//   it first, at most one task is waiting to be released.
+void sched_release_dead ();
+
+// sched_sleep_enqueue (struct sched_proc * proc);
+// sched_sleep_dequeue (struct sched_proc * proc);
+//   Add proc to (remove it from) the queue of sleeping processes
+//   that are waiting to have their stacks trimmed.
+void sched_sleep_enqueue (struct sched_proc * proc);
+void sched_sleep_dequeue (struct sched_proc * proc);
+
+// sched_trim (struct sched_proc * proc);
+//   Release (MADV_DONTNEED) the pages of the stack of a sleeping
+//   proc that lie below its saved stack pointer.
+void sched_trim (struct sched_proc * proc);
+
+// sched_settrim (unsigned long long ticks);
+//   Set how many ticks a task must sleep before its stack is
+//   trimmed (0 disables trimming).
+void sched_settrim (unsigned long long ticks);
+
+// sched_stackrss (void * stack_base);
+//   Return the number of resident bytes of the stack that ends at
+//   stack_base (0 if there is none).
+unsigned long long sched_stackrss (void * stack_base);
+
+// sched_getrss (unsigned int pid);
+//   Return the number of resident stack bytes of process pid
+//   (0 for zombies, whose stacks are already gone).
+unsigned long long sched_getrss (unsigned int pid);
+
+// sched_memstat (struct sched_memstat * ms);
+//   Fill in ms with the scheduler's memory accounting; the
+//   resident figures are sampled with mincore () at the time of
+//   the call.  Returns 0, or -1 on error.
+int sched_memstat (struct sched_memstat * ms);
+
+// sched_clock ();
+//   Return a monotonic timestamp in nanoseconds, from the TSC (rdtscp)
+//   if it is invariant, or else from clock_gettime (CLOCK_MONOTONIC).
+//   Used for the cpu time and run delay accounting.
+unsigned long long sched_clock ();
+
+// sched_clock_init ();
+//   Check for an invariant TSC and measure its frequency against
+//   CLOCK_MONOTONIC (over SCHED_TSC_CALIBRATE ns).  Used by sched_init ()
+//   and sched_restore ().
+void sched_clock_init ();
+
+// sched_account ();
+//   Charge the time since sched_run_start to the current process (its
+//   runtime and slice_acc) and to its task group, and restart
+//   sched_run_start.  Returns 1 if the group is now throttled.
+int sched_account ();
+
+// sched_effprio (struct sched_hot * h);
+//   Return the dynamic priority of h: its static priority (19 - nice)
+//   plus a bonus of -SCHED_MAX_BONUS/2 to +SCHED_MAX_BONUS/2 that grows
+//   with its sleep_avg, clamped to 0..39.  Processes that mostly sleep
+//   (I/O-bound) are favored over those that use up their slices.
+unsigned short int sched_effprio (struct sched_hot * h);
+
+// sched_wakeup (struct sched_proc * proc);
+//   Make the SLEEPING proc READY, crediting the time it slept to its
+//   sleep_avg.  If its dynamic priority beats that of the current
+//   process by at least sched_wakeup_margin (or the current process
+//   is no longer running), it becomes sched_wakee and is switched to
+//   at the next safe point (sched_tick () or sched_switch ()).
+void sched_wakeup (struct sched_proc * proc);
+
+// sched_setwakeup (int margin);
+//   Set the dynamic priority lead a woken task needs to preempt the
+//   running one.  A negative margin disables wakeup preemption.
+void sched_setwakeup (int margin);
+
+// sched_getdelay (unsigned int pid, unsigned long long * run_delay, unsigned long long * pcount);
+//   Store the total time (in ns) that living process pid has spent READY
+//   waiting for the cpu in *run_delay, and the number of times it has
+//   been switched to in *pcount.  Returns 0 or -1 on error.
+int sched_getdelay (unsigned int pid, unsigned long long * run_delay, unsigned long long * pcount);
+
+// sched_allocproc ();
+// sched_freeproc (struct sched_proc * proc);
+//   Allocate a sched_proc along with its procnodes, zombie record and
+//   child link (returns NULL on error), or free one that was never
+//   passed to sched_newproc () successfully.
+struct sched_proc * sched_allocproc ();
+void sched_freeproc (struct sched_proc * proc);
+
+// sched_newproc (struct sched_proc * parent, struct sched_proc * child_proc, void * new_sp, struct savectx * child_ctx);
+//   Make child_proc (from sched_allocproc ()) a READY child of parent
+//   that runs on the stack mapped at new_sp (STACK_SIZE bytes) and
+//   starts at child_ctx: claim a pid and link it into the process lists.
+//   Allocates nothing.  Used by sched_fork () and sched_spawnat ().
+//   Returns child_proc, or NULL on error (child_proc and the stack are
+//   left to the caller).
+struct sched_proc * sched_newproc (struct sched_proc * parent, struct sched_proc * child_proc, void * new_sp, struct savectx * child_ctx);
+
+// sched_spawn (void (* fn) (void *), void * arg);
+//   Create a child of the current task that runs fn (arg) on a fresh
+//   stack and then exits with code 0.  Returns the child's pid, or -1
+//   on error.
+int sched_spawn (void (* fn) (void *), void * arg);
+
+// sched_spawn_copy (void (* fn) (void *), const void * arg, size_t len);
+//   Like sched_spawn (), but first copy the len bytes at arg to the top
+//   of the child's stack (16-byte aligned, at most SCHED_SPAWN_COPY_MAX
+//   bytes) and pass fn a pointer to the copy, so that the caller's
+//   buffer need not outlive the call and nothing is malloc'd for it.
+int sched_spawn_copy (void (* fn) (void *), const void * arg, size_t len);
+
+// sched_spawnproc (struct sched_proc * parent, void (* fn) (void *), void * arg, size_t len);
+//   Like sched_spawn () (if len is 0) or sched_spawn_copy (), but with the
+//   given parent and with signals already blocked (used by sched_spawn ()
+//   and sched_spawn_copy ()).
+int sched_spawnproc (struct sched_proc * parent, void (* fn) (void *), const void * arg, size_t len);
+
+// sched_spawnat (struct sched_proc * parent, struct sched_proc * child_proc, void * new_sp,
+//   void (* fn) (void *), const void * arg, size_t len);
+//   Like sched_spawnproc (), but with a sched_proc and a stack that the
+//   caller has already allocated, so that nothing is allocated here (used
+//   by sched_inbox_drain (), which may run in the tick handler).  Returns
+//   the child's pid, or -1 on error (child_proc and the stack are then
+//   left to the caller).
+int sched_spawnat (struct sched_proc * parent, struct sched_proc * child_proc, void * new_sp,
+	void (* fn) (void *), const void * arg, size_t len);
+
+// sched_spawn_entry ();
+//   Where a spawned process starts out: runs its spawn_fn and exits.
+void sched_spawn_entry ();
+
+// sched_sleep ();
+//   Put the current task to sleep until sched_wakeup () is called for
+//   it, and switch to another task.  Must be called with signals blocked.
+void sched_sleep ();
+
+// sched_pause ();
+//   Sleep until woken up by sched_post_wake (), a message or an
+//   exiting child.  Returns right away if one of those arrived for
+//   the current task since the last sched_pause ().
+void sched_pause ();
+
+// sched_pause_ticks (unsigned long long ticks);
+//   Like sched_pause (), but also wake up once sched_ticks has advanced
+//   by ticks (0 means no timeout).  Returns 1 if woken up (or a wakeup
+//   was pending), 0 if the time ran out.  While nothing else is READY,
+//   sched_switch () skips the ticks ahead to the earliest timeout.
+int sched_pause_ticks (unsigned long long ticks);
+
+// sched_timer_enqueue (struct sched_proc * proc, unsigned long long tick);
+// sched_timer_dequeue (struct sched_proc * proc);
+//   Add proc to (remove it from) the queue of processes that are to be
+//   woken up when sched_ticks reaches tick.
+void sched_timer_enqueue (struct sched_proc * proc, unsigned long long tick);
+void sched_timer_dequeue (struct sched_proc * proc);
+
+// sched_timer_expire ();
+//   Wake up (and dequeue) the processes whose timeout has been reached.
+void sched_timer_expire ();
+
+// sched_post_spawn (void (* fn) (void *), void * arg);
+// sched_post_wake (unsigned int pid);
+// sched_post_msg (unsigned int pid, const void * buf, size_t len);
+//   Post a message to the scheduler's inbox: start a new child of init
+//   running fn (arg), wake up process pid, or deliver a copy of the
+//   len bytes at buf to the mailbox of process pid (waking it up).
+//   These may be called from any thread, at any time (also before
+//   sched_init ()); posting takes a malloc and a few atomic operations,
+//   plus a write to an eventfd if the scheduler is idle.  The poster
+//   also frees the messages the scheduler is done with, and
+//   sched_post_spawn maps the new stack and allocates the sched_proc,
+//   so the scheduler neither allocates nor frees when it takes messages
+//   (which it may do in its tick handler); malloc's own locks are thus
+//   only taken by the posting threads.  The messages are acted upon by
+//   the scheduler at its next tick or switch; those for processes that
+//   do not exist (any more) are dropped.
+//   Threads other than the one running the scheduler should block
+//   SIGVTALRM and SIGABRT.  Return 0, or -1 on error.
+int sched_post_spawn (void (* fn) (void *), void * arg);
+int sched_post_wake (unsigned int pid);
+int sched_post_msg (unsigned int pid, const void * buf, size_t len);
+
+// sched_recv (void * buf, size_t len);
+//   Take the oldest message out of the current task's mailbox, sleeping
+//   until there is one, and copy up to len bytes of it to buf.
+//   Returns the full length of the message.
+size_t sched_recv (void * buf, size_t len);
+
+// sched_poll ();
+//   Return the length of the oldest message in the current task's
+//   mailbox (which sched_recv () would then take without sleeping),
+//   or -1 if the mailbox is empty.
+long sched_poll ();
+
+// sched_inbox_init ();
+//   Create the eventfd the inbox uses to wake an idle scheduler.
+//   Used by sched_init () and sched_restore ().  Returns 0, or -1 on error.
+int sched_inbox_init ();
+
+// sched_inbox_drain ();
+//   Act upon every message in the inbox (scheduler thread only, with
+//   signals blocked); allocates and frees nothing, so it is also called
+//   from sched_tick ().  Returns the number of messages taken.
+int sched_inbox_drain ();
+
+// sched_inbox_idle ();
+//   Block until the inbox is not empty (used by sched_switch () when
+//   nothing is READY but some task sleeps), with SIGINT and SIGTERM
+//   unblocked.  Returns 0, or -1 on error or if nothing has ever been
+//   posted (in a program without posting threads, nothing could wake
+//   a task up, and sched_switch () gives up).
+int sched_inbox_idle ();
+
+// sched_inbox_reclaim ();
+//   Free the messages the scheduler is done with (and the stack and
+//   sched_proc of a posted process that could not be spawned).  Called
+//   by every posting thread before it posts, and by the scheduler from
+//   sched_release_dead (), so that nothing piles up once posting stops
+//   (init exits through there as well).  Never called in the tick handler.
+void sched_inbox_reclaim ();
+
+// sched_mbox_free (struct sched_proc * proc);
+//   Free the messages left in the mailbox of proc.
+void sched_mbox_free (struct sched_proc * proc);
+
+// sched_stats_open (const char * name);
+//   Create the shared-memory segment name (by default SCHED_STATS_NAME,
+//   if name is NULL) and publish the stats table in it from now on; it
+//   is removed again when the program exits (with exit () or by returning
+//   from main).  A program that is killed or crashes leaves its segment
+//   behind, so with the default name, segments of programs whose pid no
+//   longer exists are removed first.  Used by sched_init () and
+//   sched_restore ().  Returns 0, or -1 on error (the scheduler then
+//   runs on without the table).
+int sched_stats_open (const char * name);
+
+// sched_stats_close ();
+//   Stop publishing the stats table and remove its segment.
+void sched_stats_close ();
+
+// sched_stats_publish (struct sched_proc * prev);
+//   Update the header and the rows of prev and current from sched_hot
+//   after a switch away from prev (called by sched_switch ()); only the
+//   stack usage and parent of prev are taken from a cold sched_proc (so
+//   the ppid of an orphan is brought up to date the next time it runs).
+void sched_stats_publish (struct sched_proc * prev);
+
+// sched_stats_update (unsigned int pid);
+//   Update the row of pid from sched_hot, for the changes that do not
+//   involve the processes on either side of a switch (a process is
+//   created, woken up or reaped).
+void sched_stats_update (unsigned int pid);
+
+// sched_stats_tick ();
+//   Update the row of the current process (called by sched_tick ()).
+void sched_stats_tick ();
+
+// sched_stats_ident (unsigned int pid, unsigned int ppid, void * stack_base);
+//   Update the identity columns of the row of pid (when a process is
+//   created, reparented or exits).
+void sched_stats_ident (unsigned int pid, unsigned int ppid, void * stack_base);
+
+// sched_group_create (unsigned int parent, unsigned int shares);
+//   Create a new task group below the group parent, with the given
+//   cpu shares (clamped to SCHED_SHARES_MIN..SCHED_SHARES_MAX).
+//   The group has no bandwidth limit until sched_group_setbw ().
+//   Returns the gid of the new group, or -1 on error.
+int sched_group_create (unsigned int parent, unsigned int shares);
+
+// sched_group_destroy (unsigned int gid);
+//   Release a group that has no processes and no child groups.
+//   The root group cannot be destroyed.  Returns 0 or -1 on error.
+int sched_group_destroy (unsigned int gid);
+
+// sched_group_setbw (unsigned int gid, unsigned long long quota, unsigned long long period);
+//   Limit the group (including its descendants) to quota ticks of
+//   cpu time every period ticks.  A quota of 0 removes the limit.
+//   Returns 0 or -1 on error.
+int sched_group_setbw (unsigned int gid, unsigned long long quota, unsigned long long period);
+
+// sched_group_join (unsigned int gid);
+//   Move the current task into group gid.  Children forked afterwards
+//   inherit the group.  Returns 0 or -1 on error.
+int sched_group_join (unsigned int gid);
+
+// sched_getgroup ();
+//   Return the gid of the current task's group.
+unsigned int sched_getgroup ();
+
+// sched_group_refresh (struct sched_group * g);
+//   Start a new bandwidth period for g if its current one has
+//   elapsed, clearing its runtime and throttled state.
+void sched_group_refresh (struct sched_group * g);
+
+// sched_group_charge (unsigned int gid, unsigned long long ns);
+//   Charge ns of cpu time to group gid and all of its ancestors.
+//   Returns 1 if the group or one of its ancestors is now throttled.
+int sched_group_charge (unsigned int gid, unsigned long long ns);
+
+// sched_group_throttled (unsigned int gid);
+//   Return 1 if group gid or one of its ancestors is throttled
+//   (refreshing their bandwidth periods first), 0 otherwise.
+int sched_group_throttled (unsigned int gid);
+
+// sched_group_enqueue (unsigned int gid);
+// sched_group_dequeue (unsigned int gid);
+//   Count a process of group gid that becomes READY (or RUNNING) in
+//   (that stops being so out), queueing (unqueueing) the group and
+//   those of its ancestors whose subtree that makes (no longer) have
+//   any.  A group that is queued again starts no lower than the least
+//   vruntime it now competes with.  Called with signals blocked.
+void sched_group_enqueue (unsigned int gid);
+void sched_group_dequeue (unsigned int gid);
+
+// sched_group_pick ();
+//   Walk the queued groups from the root and return the best READY
+//   process found by sched_switch, or NULL if no unthrottled group
+//   has one.  Only valid after the sched_switch scans.
+struct sched_hot * sched_group_pick ();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
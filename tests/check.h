@@ -0,0 +1,18 @@
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// CHECK (cond);
+//   Stop the test (exit code 1) with the failed condition if cond does
+//   not hold.  Tests report on stderr, since sched_ps () lists the
+//   tasks on stdout at every switch ("make check" drops stdout).
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf (stderr, "FAIL: %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		exit (1); \
+	} \
+} while (0)
+
+#endif
@@ -0,0 +1,87 @@
+#include "usched.h"
+#include "check.h"
+
+// checkpoint/restore: run as "checkpoint path" to write a checkpoint from
+//   the middle of a run, then as "checkpoint -r path" (with the same address
+//   space layout, see setarch -R) to check that a damaged copy is refused
+//   and leaves nothing behind, and that the run then goes on from the file
+
+static int restored;                   // (globals are not part of a checkpoint)
+static const char * path;
+
+void init_fn () {
+	int i, cpid, code, rc;
+
+	for (i = 0; i < 3; ++i) {
+		if ((cpid = sched_fork ()) == 0) {
+			sched_nice (i * 5);
+			while (sched_gettick () < 2 + i);
+			if (i == 1) {
+				if ((rc = sched_checkpoint (path)) == 0) {
+					// the writing run stops here
+					_exit (0);
+				}
+				CHECK (rc == 1 && restored);
+			}
+			while (sched_gettick () < 5);
+			sched_exit (100 + i);
+		}
+	}
+
+	// the children are pids 2 to 4 and come back with their exit codes
+	for (i = 0; i < 3; ++i) {
+		CHECK ((cpid = sched_wait (&code)) > 1);
+		CHECK (code == 100 + cpid - 2);
+	}
+	CHECK (restored);
+
+	fprintf (stderr, "ok checkpoint\n");
+	exit (0);
+}
+
+// copy the file src to dst, making the parent of the last process record
+//   one that does not exist
+static void corrupt (const char * src, const char * dst) {
+	struct sched_ckpt_header hdr;
+	struct sched_ckpt_proc rec;
+	FILE * in, * out;
+	char buf[4096];
+	size_t n;
+	long off;
+
+	CHECK ((in = fopen (src, "rb")) != NULL && (out = fopen (dst, "w+b")) != NULL);
+	while ((n = fread (buf, 1, sizeof (buf), in)) > 0) {
+		CHECK (fwrite (buf, 1, n, out) == n);
+	}
+	fclose (in);
+
+	CHECK (fseek (out, 0, SEEK_SET) == 0 && fread (&hdr, sizeof (hdr), 1, out) == 1);
+	CHECK (hdr.nproc >= 2);
+	off = sizeof (hdr) + (long) (hdr.nproc - 1) * sizeof (rec);
+	CHECK (fseek (out, off, SEEK_SET) == 0 && fread (&rec, sizeof (rec), 1, out) == 1);
+	rec.ppid = SCHED_NPROC - 1;
+	CHECK (fseek (out, off, SEEK_SET) == 0 && fwrite (&rec, sizeof (rec), 1, out) == 1);
+	fclose (out);
+}
+
+int main (int argc, char ** argv) {
+	char bad[4096];
+
+	if (argc == 2) {
+		path = argv[1];
+		sched_init (init_fn);
+		return 1;
+	}
+	CHECK (argc == 3 && strcmp (argv[1], "-r") == 0);
+	path = argv[2];
+	restored = 1;
+
+	// (the damaged copy is expected to print an error)
+	snprintf (bad, sizeof (bad), "%s.bad", path);
+	corrupt (path, bad);
+	CHECK (sched_restore (bad) < 0);
+	unlink (bad);
+
+	sched_restore (path);
+	return 1;
+}
@@ -0,0 +1,58 @@
+#include <time.h>
+#include "usched.h"
+#include "check.h"
+
+// cpu time accounting: sched_clock keeps time with CLOCK_MONOTONIC, a task
+//   that spins alone is charged the time it spun, and one that only runs
+//   briefly before it sleeps is charged for that, in ns rather than ticks
+
+static unsigned long long monotonic () {
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void init_fn () {
+	unsigned long long c0, m0, c, m, t0, r0, pcount;
+	int cpid, code;
+
+	// ~50 ms of busy waiting, timed both ways (within 5%)
+	c0 = sched_clock ();
+	m0 = monotonic ();
+	while (monotonic () - m0 < 50000000);
+	c = sched_clock () - c0;
+	m = monotonic () - m0;
+	CHECK (c > m - m / 20 && c < m + m / 20);
+
+	// spinning for 3 more ticks of cpu time takes 2 to 3 ticks from here
+	t0 = sched_gettick ();
+	r0 = current->hot->runtime;
+	m0 = monotonic ();
+	while (sched_gettick () - t0 < 3);
+	m = monotonic () - m0;
+	CHECK (m > 2 * SCHED_TICK_NS && m < 3 * SCHED_TICK_NS + SCHED_TICK_NS / 5);
+	CHECK (current->hot->runtime - r0 >= 2 * SCHED_TICK_NS);        // (as of the last tick)
+
+	// the child is on the cpu for microseconds before it falls asleep, and
+	//   is charged exactly that (no tick passes while it runs, so counting
+	//   ticks would charge it nothing at all)
+	if ((cpid = sched_fork ()) == 0) {
+		sched_pause ();
+		sched_exit (0);
+	}
+	sched_pause_ticks (1);                    // (let the child run and fall asleep)
+	CHECK (sched_getdelay (cpid, &r0, &pcount) == 0 && pcount == 1);
+	CHECK (sched_hot[cpid].runtime > 0 && sched_hot[cpid].runtime < SCHED_TICK_NS / 10);
+
+	CHECK (sched_post_wake (cpid) == 0);
+	CHECK (sched_wait (&code) == cpid && code == 0);
+
+	fprintf (stderr, "ok clock\n");
+	exit (0);
+}
+
+int main () {
+	sched_init (init_fn);
+	return 1;
+}
@@ -0,0 +1,188 @@
+#include <pthread.h>
+#include <string>
+#include "sched.hpp"
+#include "check.h"
+
+// the C++ front-end: spawn and join, the executor with sleeps, channels,
+//   child waits and mailbox receives (the message is posted by a thread)
+
+struct msg {
+	int a;
+	double b;
+};
+
+static unsigned int exec_pid;
+static int woke[2], nwoke;
+
+sched::job sleeper (int id, unsigned long long ticks, sched::channel<int> & ch) {
+	co_await sched::sleep_for (ticks);
+	woke[nwoke++] = id;
+	ch.send (id);
+}
+
+sched::job collector (sched::channel<int> & ch, int n, int & sum) {
+	for (int i = 0; i < n; ++i) {
+		sum += co_await ch.recv ();
+	}
+}
+
+sched::job child_waiter (int & code) {
+	int x = 7;
+	sched::task t = sched::spawn ([x] { unsigned long long s = sched_gettick (); while (sched_gettick () - s < 2); return x * 6; });
+	code = co_await t.wait ();
+}
+
+sched::job mailer (msg & m) {
+	m = co_await sched::receive<msg> ();
+}
+
+sched::job many (sched::channel<int> & done, int i) {
+	co_await sched::sleep_for (1 + i % 3);
+	done.send (1);
+}
+
+sched::job count (sched::channel<int> & done, int n, int & c) {
+	for (int i = 0; i < n; ++i) {
+		c += co_await done.recv ();
+	}
+}
+
+// mailbox receives are served in order: a receive made while another job
+//   is parked on the mailbox does not overtake it, even with mail there
+sched::job recv_first (int & v) {
+	v = co_await sched::receive<int> ();
+}
+
+sched::job post_two () {
+	int one = 1, two = 2;
+	sched_post_msg (sched_getpid (), &one, sizeof (one));
+	sched_post_msg (sched_getpid (), &two, sizeof (two));
+	while (sched_poll () < 0);              // (delivered at the next tick)
+	co_return;
+}
+
+// a wait that is dropped before the child exits still reaps it
+sched::job drop_wait (unsigned int & pid) {
+	sched::task t = sched::spawn ([] { unsigned long long s = sched_gettick (); while (sched_gettick () - s < 2); });
+	pid = t.pid ();
+	{
+		sched::wait_child w = t.wait ();
+	}
+	co_return;
+}
+
+// a job that is parked when its executor goes away is destroyed with it
+struct guard {
+	int & n;
+	~guard () { ++n; }
+};
+
+sched::job parked (sched::channel<int> & ch, int & destroyed) {
+	guard g {destroyed};
+	co_await ch.recv ();                    // (nobody sends)
+}
+
+void * poster (void *) {
+	sigset_t s;
+	sigemptyset (&s);
+	sigaddset (&s, SIGVTALRM);
+	sigaddset (&s, SIGABRT);
+	pthread_sigmask (SIG_BLOCK, &s, NULL);
+	while (exec_pid == 0) {
+		usleep (1000);
+	}
+	usleep (100000);
+	msg m {42, 2.5};
+	sched_post_msg (exec_pid, &m, sizeof (m));
+	return nullptr;
+}
+
+void init_fn () {
+	// a trivially copyable lambda (copied onto the child's stack) and one that is not (heap)
+	int a = 3, b = 4;
+	sched::task t1 = sched::spawn ([a, b] { return a + b; });
+	std::string s = "hello";
+	sched::task t2 = sched::spawn ([s] { return (int) s.size (); });
+	CHECK (t1.join () == 7);
+	CHECK (t2.join () == 5);
+	CHECK (t1.joinable () == false);
+	{
+		sched::task t3 = sched::spawn ([] { return 1; });  // reaped by the destructor
+	}
+
+	// an executor in a task of its own
+	sched::task ex = sched::spawn ([] {
+		pthread_t th;
+		exec_pid = sched_getpid ();
+		pthread_create (&th, NULL, poster, NULL);
+
+		sched::executor e;
+		sched::channel<int> ch, done;
+		int sum = 0, code = 0, c = 0;
+		msg m {0, 0};
+		e.spawn (sleeper (1, 3, ch));
+		e.spawn (sleeper (2, 1, ch));
+		e.spawn (collector (ch, 2, sum));
+		e.spawn (child_waiter (code));
+		e.spawn (mailer (m));
+		for (int i = 0; i < 5000; ++i) {
+			e.spawn (many (done, i));
+		}
+		e.spawn (count (done, 5000, c));
+		e.run ();
+		pthread_join (th, NULL);
+
+		CHECK (e.size () == 0);
+		CHECK (nwoke == 2 && woke[0] == 2 && woke[1] == 1);
+		CHECK (sum == 3);
+		CHECK (code == 42);
+		CHECK (m.a == 42 && m.b == 2.5);
+		CHECK (c == 5000);
+		return 5;
+	});
+	CHECK (ex.join () == 5);
+
+	sched::task fifo = sched::spawn ([] {
+		sched::executor e;
+		int first = 0, second = 0;
+		e.spawn (recv_first (first));           // parks: the mailbox is empty
+		e.spawn (post_two ());
+		e.spawn (recv_first (second));          // mail is there now, but the first job waits longer
+		e.run ();
+		CHECK (first == 1 && second == 2);
+		return 0;
+	});
+	CHECK (fifo.join () == 0);
+
+	sched::task owner = sched::spawn ([] {
+		unsigned int pid = 0;
+		int destroyed = 0;
+		{
+			sched::executor e;
+			e.spawn (drop_wait (pid));
+			e.run ();
+		}
+		CHECK (pid != 0 && sched_hot[pid].task_state == SCHED_UNUSED);   // (reaped: the pid is free)
+		{
+			sched::executor e;
+			sched::channel<int> ch;
+			e.spawn (parked (ch, destroyed));
+			try {
+				e.run ();
+			} catch (const std::logic_error &) {
+			}
+			CHECK (destroyed == 0);
+		}
+		CHECK (destroyed == 1);
+		return 0;
+	});
+	CHECK (owner.join () == 0);
+
+	fprintf (stderr, "ok cpp\n");
+	exit (0);
+}
+
+int main () {
+	sched_init (init_fn);
+	return 1;
+}
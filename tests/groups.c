@@ -0,0 +1,61 @@
+#include "usched.h"
+#include "check.h"
+
+// task groups: children inherit the group of their parent, groups are only
+//   destroyed once empty, and a group throttled by a quota (even one nested
+//   below an unlimited group) neither overruns it nor holds up the others
+
+static void spin (unsigned long long ticks) {
+	unsigned long long t;
+
+	t = sched_gettick ();
+	while (sched_gettick () - t < ticks);
+}
+
+void init_fn () {
+	int a, b, c, cpid, code;
+	unsigned long long t0;
+
+	CHECK (sched_getgroup () == 0);
+	CHECK ((a = sched_group_create (0, SCHED_SHARES_DEFAULT)) > 0);
+	CHECK ((b = sched_group_create (a, SCHED_SHARES_DEFAULT)) > 0);
+
+	if ((cpid = sched_fork ()) == 0) {
+		CHECK (sched_group_join (a) == 0 && sched_getgroup () == (unsigned int) a);
+		if (sched_fork () == 0) {
+			CHECK (sched_getgroup () == (unsigned int) a);
+			sched_exit (0);
+		}
+		CHECK (sched_wait (&code) > 0 && code == 0);
+		sched_exit (0);
+	}
+	CHECK (sched_waitpid (cpid, &code, 0) == cpid && code == 0);
+	CHECK (sched_groups[a].nr_tasks == 0);
+
+	// (this one is expected to print an error: a still has the child group b)
+	CHECK (sched_group_destroy (a) < 0);
+	CHECK ((c = sched_group_create (a, SCHED_SHARES_DEFAULT)) > 0);
+	CHECK (sched_group_destroy (c) == 0 && sched_groups[c].in_use == 0);
+
+	// b gets 1 tick every 20; a task of the root group has to run almost
+	//   all the time next to one that spins in b
+	CHECK (sched_group_setbw (b, 1, 20) == 0);
+	if (sched_fork () == 0) {
+		sched_group_join (b);
+		spin (1000);
+		sched_exit (1);
+	}
+	t0 = sched_ticks;
+	spin (10);
+	CHECK (sched_ticks - t0 <= 14);
+	CHECK (sched_groups[b].runtime <= 2 * SCHED_TICK_NS);
+	CHECK (sched_groups[a].runtime <= 2 * SCHED_TICK_NS);
+
+	fprintf (stderr, "ok groups\n");
+	exit (0);
+}
+
+int main () {
+	sched_init (init_fn);
+	return 1;
+}
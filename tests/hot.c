@@ -0,0 +1,43 @@
+#include "usched.h"
+#include "check.h"
+
+// the hot/cold split: every living process keeps its scheduling state in
+//   the sched_hot slot of its pid (two per cache line), and the slot
+//   follows it from READY through RUNNING and ZOMBIE back to UNUSED
+
+void init_fn () {
+	int cpid, code;
+	unsigned int pid;
+
+	CHECK (sizeof (struct sched_hot) == 32);
+	CHECK (current->hot == &sched_hot[1] && sched_hot[1].proc == current);
+	CHECK (sched_hot[1].task_state == SCHED_RUNNING);
+
+	sched_nice (5);
+	if ((cpid = sched_fork ()) == 0) {
+		// the child inherits the nice value and runs in its own slot
+		pid = sched_getpid ();
+		CHECK (current->hot == &sched_hot[pid] && sched_hot[pid].proc == current);
+		CHECK (sched_hot[pid].task_state == SCHED_RUNNING && sched_hot[pid].nice == 5);
+		CHECK (sched_hot[1].task_state != SCHED_RUNNING);
+		sched_exit (42);
+	}
+	CHECK (cpid > 1);
+	CHECK (sched_hot[cpid].proc != NULL && sched_hot[cpid].proc->pid == (unsigned int) cpid);
+	CHECK (sched_hot[cpid].task_state == SCHED_READY);
+
+	// once the child has exited, only its slot says so (the sched_proc is gone)
+	sched_pause ();
+	CHECK (sched_hot[cpid].task_state == SCHED_ZOMBIE && sched_hot[cpid].proc == NULL);
+
+	CHECK (sched_wait (&code) == cpid && code == 42);
+	CHECK (sched_hot[cpid].task_state == SCHED_UNUSED);
+
+	fprintf (stderr, "ok hot\n");
+	exit (0);
+}
+
+int main () {
+	sched_init (init_fn);
+	return 1;
+}
@@ -0,0 +1,80 @@
+#include <malloc.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "usched.h"
+#include "check.h"
+
+// the inbox: another thread posts messages (in order) and a spawn before the
+//   scheduler even starts, wakes init up from an idle scheduler, and the
+//   messages the scheduler drops are freed again
+
+static pthread_t poster;
+static atomic_int phase;               // 1 once the posts before sched_init are in, 2 once init is about to pause
+static atomic_int spawned;
+
+static void spawn_fn (void * arg) {
+	CHECK (arg == &spawned && sched_getppid () == 1);
+	atomic_store (&spawned, 1);
+	sched_exit (5);
+}
+
+static void * post_fn (void * arg) {
+	int i;
+
+	CHECK (sched_post_msg (1, "one", 4) == 0);
+	CHECK (sched_post_msg (1, "two", 4) == 0);
+	CHECK (sched_post_spawn (spawn_fn, &spawned) == 0);
+	atomic_store (&phase, 1);
+
+	// wake init once the scheduler has nothing left to run
+	while (atomic_load (&phase) != 2);
+	usleep (100000);
+	CHECK (sched_post_wake (1) == 0);
+
+	// (no such process: these are dropped)
+	for (i = 0; i < 1000; ++i) {
+		CHECK (sched_post_wake (99) == 0);
+	}
+
+	return arg;
+}
+
+void init_fn () {
+	char buf[8];
+	size_t before;
+	int code;
+
+	// (the posts are taken in at the first tick or switch)
+	CHECK (sched_recv (buf, sizeof (buf)) == 4 && strcmp (buf, "one") == 0);
+	CHECK (sched_poll () == 4);
+	CHECK (sched_recv (buf, sizeof (buf)) == 4 && strcmp (buf, "two") == 0);
+	CHECK (sched_poll () == -1);
+
+	CHECK (sched_wait (&code) > 1 && code == 5 && atomic_load (&spawned));
+
+	atomic_store (&phase, 2);
+	CHECK (sched_pause_ticks (0) == 1);
+
+	// the dropped wakeups are freed once the scheduler has taken them
+	CHECK (pthread_join (poster, NULL) == 0);
+	before = mallinfo2 ().uordblks;
+	sched_pause_ticks (1);
+	CHECK (mallinfo2 ().uordblks + 1000 * 32 < before);
+
+	fprintf (stderr, "ok inbox\n");
+	exit (0);
+}
+
+int main () {
+	sigset_t all, old;
+
+	// the poster must not take the scheduler's signals (see sched_post_spawn)
+	sigfillset (&all);
+	pthread_sigmask (SIG_BLOCK, &all, &old);
+	CHECK (pthread_create (&poster, NULL, post_fn, NULL) == 0);
+	pthread_sigmask (SIG_SETMASK, &old, NULL);
+
+	while (atomic_load (&phase) != 1);
+	sched_init (init_fn);
+	return 1;
+}
@@ -0,0 +1,64 @@
+#include "usched.h"
+#include "check.h"
+
+// stack and zombie memory: an exited task is only a small zombie record
+//   until it is reaped, its stack goes as soon as another task resumes, and
+//   the unused part of the stack of a long sleeper is released (trimmed)
+
+static void spin (unsigned long long ticks) {
+	unsigned long long t;
+
+	t = sched_gettick ();
+	while (sched_gettick () - t < ticks);
+}
+
+// touch most of the stack, so that it is resident when the task sleeps
+static void deep () {
+	volatile char buf[STACK_SIZE / 2];
+	size_t i;
+
+	for (i = 0; i < sizeof (buf); i += 4096) {
+		buf[i] = 1;
+	}
+}
+
+void init_fn () {
+	struct sched_memstat ms;
+	int cpid, code;
+
+	if ((cpid = sched_fork ()) == 0) {
+		sched_exit (7);
+	}
+	sched_pause ();
+	sched_memstat (&ms);
+	CHECK (ms.stack_released == STACK_SIZE && ms.stack_mapped == STACK_SIZE);
+	CHECK (ms.zombies == 1 && ms.zombie_bytes > 0 && ms.zombie_bytes < STACK_SIZE);
+
+	CHECK (sched_wait (&code) == cpid && code == 7);
+	sched_memstat (&ms);
+	CHECK (ms.zombies == 0 && ms.zombie_bytes == 0);
+
+	// a child asleep for more than a tick loses the stack it no longer uses
+	sched_settrim (1);
+	if ((cpid = sched_fork ()) == 0) {
+		deep ();
+		sched_pause_ticks (5);
+		sched_exit (8);
+	}
+	sched_pause_ticks (1);                    // (let the child run and fall asleep)
+	spin (3);
+	sched_memstat (&ms);
+	CHECK (ms.stack_trimmed > 0);
+
+	CHECK (sched_wait (&code) == cpid && code == 8);
+	sched_memstat (&ms);
+	CHECK (ms.stack_released == 2 * STACK_SIZE && ms.stack_mapped == STACK_SIZE);
+
+	fprintf (stderr, "ok memstat\n");
+	exit (0);
+}
+
+int main () {
+	sched_init (init_fn);
+	return 1;
+}
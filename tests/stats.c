@@ -0,0 +1,89 @@
+#include <sys/wait.h>
+#include "usched.h"
+#include "check.h"
+
+// the stats table: the segment left behind by a program that is gone is
+//   swept when the scheduler starts, the table is readable by name from a
+//   separate mapping (as schedtop reads it) and shows what sched_hot holds,
+//   and the segment is removed when the program exits
+
+static char name[64], dead_name[64];
+static int passed;
+
+// (runs after the scheduler's own exit handler, which was registered later)
+static void check_removed () {
+	if (!passed) return;
+	if (shm_open (name, O_RDONLY, 0) >= 0) {
+		fprintf (stderr, "FAIL: %s:%d: segment %s left behind\n", __FILE__, __LINE__, name);
+		_exit (1);
+	}
+	fprintf (stderr, "ok stats\n");
+}
+
+// compare the rows of every process but the current one (whose row follows
+//   it at every tick) with sched_hot
+static void check_rows (const struct sched_stats * st) {
+	unsigned int pid;
+
+	CHECK (st->pid_max == sched_pid_max);
+	for (pid = 1; pid <= sched_pid_max; ++pid) {
+		if (pid == current->pid) continue;
+		CHECK (st->rows[pid].task_state == sched_hot[pid].task_state);
+		CHECK (st->rows[pid].nice == sched_hot[pid].nice);
+		CHECK (st->rows[pid].priority == sched_hot[pid].priority);
+		CHECK (st->rows[pid].group == sched_hot[pid].group);
+	}
+}
+
+void init_fn () {
+	const struct sched_stats * st;
+	int fd, i, code;
+
+	CHECK (shm_open (dead_name, O_RDONLY, 0) < 0 && errno == ENOENT);
+
+	CHECK ((fd = shm_open (name, O_RDONLY, 0)) >= 0);
+	CHECK ((st = mmap (0, sizeof (struct sched_stats), PROT_READ, MAP_SHARED, fd, 0)) != MAP_FAILED);
+	close (fd);
+	CHECK (memcmp (st->magic, SCHED_STATS_MAGIC, sizeof (SCHED_STATS_MAGIC)) == 0);
+	CHECK (st->version == SCHED_STATS_VERSION);
+
+	for (i = 0; i < 6; ++i) {
+		if (sched_fork () == 0) {
+			sched_nice (i * 3 - 8);
+			if (i % 2) {
+				sched_pause_ticks (2);
+			}
+			while (sched_gettick () < 3);
+			sched_exit (i);
+		}
+	}
+	check_rows (st);
+	CHECK (st->rows[2].pid == 2 && st->rows[2].ppid == 1);
+	for (i = 0; i < 6; ++i) {
+		CHECK (sched_wait (&code) > 1);
+		check_rows (st);
+	}
+	CHECK (st->rows[2].task_state == SCHED_UNUSED);
+
+	passed = 1;
+	exit (0);
+}
+
+int main () {
+	pid_t dead;
+	int fd;
+
+	// a segment named after a pid that no longer exists
+	if ((dead = fork ()) == 0) {
+		_exit (0);
+	}
+	CHECK (dead > 0 && waitpid (dead, NULL, 0) == dead);
+	snprintf (dead_name, sizeof (dead_name), SCHED_STATS_NAME, (int) dead);
+	CHECK ((fd = shm_open (dead_name, O_CREAT | O_RDWR, 0600)) >= 0);
+	close (fd);
+
+	snprintf (name, sizeof (name), SCHED_STATS_NAME, (int) getpid ());
+	atexit (check_removed);
+	sched_init (init_fn);
+	return 1;
+}
@@ -0,0 +1,91 @@
+#include "usched.h"
+#include "check.h"
+
+// orphan reparenting: the children and zombies of an exiting task go to its
+//   nearest subreaper ancestor (here b, below a) or else to init, and they
+//   see their new parent straight away
+
+#define N 20
+
+static unsigned int b_pid;
+
+static void quick_fn (void * arg) {
+	sched_exit ((int) (long) arg);
+}
+
+static void orphan_fn (void * arg) {
+	sched_pause_ticks (3);
+	CHECK (sched_getppid () == b_pid);
+	sched_exit ((int) (long) arg);
+}
+
+// c leaves N children behind, half of them already zombies
+static void c_fn (void * arg) {
+	int i;
+
+	for (i = 0; i < N; ++i) {
+		CHECK (sched_spawn (i % 2 ? quick_fn : orphan_fn, (void *) (long) i) > 0);
+	}
+	sched_pause_ticks (1);
+	sched_exit (100);
+}
+
+static void b_fn (void * arg) {
+	int n, sum, code;
+
+	sched_set_subreaper (1);
+	b_pid = sched_getpid ();
+	CHECK (sched_spawn (c_fn, NULL) > 0);
+
+	// c and then all of its children
+	for (n = sum = 0; n < N + 1; ++n) {
+		CHECK (sched_wait (&code) > 0);
+		sum += code;
+	}
+	CHECK (sum == 100 + N * (N - 1) / 2);
+	sched_exit (0);
+}
+
+static void a_fn (void * arg) {
+	int code;
+
+	CHECK (sched_spawn (b_fn, NULL) > 0);
+	CHECK (sched_wait (&code) > 0 && code == 0);
+	sched_exit (1);
+}
+
+// without a subreaper in between, init adopts
+static void d_fn (void * arg) {
+	sched_pause_ticks (2);
+	CHECK (sched_getppid () == 1);
+	sched_exit (2);
+}
+
+static void e_fn (void * arg) {
+	CHECK (sched_spawn (d_fn, NULL) > 0);
+	sched_exit (3);
+}
+
+void init_fn () {
+	struct sched_memstat ms;
+	int n, sum, code;
+
+	CHECK (sched_spawn (a_fn, NULL) > 0);
+	CHECK (sched_spawn (e_fn, NULL) > 0);
+	for (n = sum = 0; n < 3; ++n) {
+		CHECK (sched_wait (&code) > 0);
+		sum += code;
+	}
+	CHECK (sum == 1 + 2 + 3);
+
+	sched_memstat (&ms);
+	CHECK (ms.zombies == 0);
+
+	fprintf (stderr, "ok subreaper\n");
+	exit (0);
+}
+
+int main () {
+	sched_init (init_fn);
+	return 1;
+}
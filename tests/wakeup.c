@@ -0,0 +1,52 @@
+#include "usched.h"
+#include "check.h"
+
+// wakeup preemption: a task that wakes up from a short sleep gets the cpu
+//   at the next tick from a spinning task of lower priority, unless wakeup
+//   preemption is disabled, in which case it waits for the spinner's slice
+
+#define ROUNDS 3
+
+static volatile int done;
+
+// average time (ns) the current task waits for the cpu after a one tick sleep
+static unsigned long long wake_delay () {
+	unsigned long long delay, last, pcount, sum;
+	int r;
+
+	sum = 0;
+	for (r = 0; r < ROUNDS; ++r) {
+		CHECK (sched_getdelay (sched_getpid (), &last, &pcount) == 0);
+		sched_pause_ticks (1);
+		CHECK (sched_getdelay (sched_getpid (), &delay, &pcount) == 0);
+		sum += delay - last;
+	}
+
+	return sum / ROUNDS;
+}
+
+void init_fn () {
+	int code;
+
+	if (sched_fork () == 0) {
+		sched_nice (10);
+		while (!done);
+		sched_exit (0);
+	}
+
+	sched_setwakeup (SCHED_WAKEUP_MARGIN);
+	CHECK (wake_delay () < SCHED_TICK_NS / 2);
+	sched_setwakeup (-1);
+	CHECK (wake_delay () >= SCHED_TICK_NS);
+
+	done = 1;
+	CHECK (sched_wait (&code) > 0 && code == 0);
+
+	fprintf (stderr, "ok wakeup\n");
+	exit (0);
+}
+
+int main () {
+	sched_init (init_fn);
+	return 1;
+}